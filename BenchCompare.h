@@ -0,0 +1,284 @@
+#ifndef BENCH_COMPARE_H
+#define BENCH_COMPARE_H
+
+// "perft compare <baseline json> <new json> [threshold %]": compare two bench runs (see BenchSuite.h)
+// for each case (position + depth) and for the total, the medians of the repeat times are compared, with a 95%
+// confidence interval for the ratio from bootstrap resampling of the repeats. A case is a regression when the whole
+// interval is above 1 (slower) and the median is slower by more than the threshold (BENCH_COMPARE_THRESHOLD % by
+// default). Returns 1 if there is any regression, 2 if the files can't be read or aren't comparable
+// (with a single repeat there is no interval, only the threshold is applied)
+//
+// only reads the json written by runBench, not json in general
+//
+// included by perft.cpp (after BenchSuite.h)
+
+#define BENCH_COMPARE_THRESHOLD     2.0
+#define BENCH_BOOTSTRAP_SAMPLES     2000
+#define BENCH_MAX_NAME              32
+
+struct BenchResult
+{
+    char   name[BENCH_MAX_NAME];
+    int    depth;
+    uint64 nodes;
+    int    numTimes;
+    double seconds[BENCH_MAX_REPEATS];
+};
+
+struct BenchRun
+{
+    int         suiteVersion;
+    char        variant[BENCH_MAX_NAME];    // engine variant and if it used the hash tables ("" and -1 if not recorded)
+    int         hashTables;
+    int         numCases;
+    BenchResult cases[NUM_BENCH_CASES];
+    BenchResult total;
+};
+
+// position right after "key": (searching from p), NULL if not found before end
+static const char *findJsonKey(const char *p, const char *end, const char *key)
+{
+    char pattern[64];
+    sprintf(pattern, "\"%s\":", key);
+    size_t len = strlen(pattern);
+    for (; p + len <= end; p++)
+    {
+        if (memcmp(p, pattern, len) == 0)
+        {
+            p += len;
+            while (p < end && *p == ' ')
+                p++;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// copies a "string" value (truncated to BENCH_MAX_NAME - 1 chars), false if it isn't one
+static bool readJsonString(const char *p, char *out)
+{
+    if (!p || *p != '"')
+        return false;
+    int len = 0;
+    p++;
+    while (p[len] && p[len] != '"' && len < BENCH_MAX_NAME - 1)
+        len++;
+    memcpy(out, p, len);
+    out[len] = 0;
+    return true;
+}
+
+// reads [a, b, ...], returns the no of values
+static int readJsonTimes(const char *p, const char *end, double *seconds)
+{
+    int n = 0;
+    if (!p || *p != '[')
+        return 0;
+    p++;
+    while (p < end && *p != ']' && n < BENCH_MAX_REPEATS)
+    {
+        char *next;
+        seconds[n] = strtod(p, &next);
+        if (next == p)
+            break;
+        n++;
+        p = next;
+        while (p < end && (*p == ',' || *p == ' '))
+            p++;
+    }
+    return n;
+}
+
+static bool readBenchRun(const char *fileName, BenchRun *run)
+{
+    memset(run, 0, sizeof(BenchRun));
+
+    FILE *fp = fopen(fileName, "rb");
+    if (!fp)
+    {
+        printf("\nFailed to open %s\n", fileName);
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *json = (char *) malloc(size + 1);
+    size = (long) fread(json, 1, size, fp);
+    json[size] = 0;
+    fclose(fp);
+
+    const char *end = json + size;
+    const char *p = findJsonKey(json, end, "suiteVersion");
+    if (p)
+        run->suiteVersion = atoi(p);
+    readJsonString(findJsonKey(json, end, "variant"), run->variant);
+    p = findJsonKey(json, end, "hashTables");
+    run->hashTables = p ? atoi(p) : -1;
+
+    // one object per case: { "name": .., "depth": .., "nodes": .., "seconds": [..] }, followed by the total
+    const char *casesEnd = findJsonKey(json, end, "totalNodes");
+    if (!casesEnd)
+        casesEnd = end;
+    p = findJsonKey(json, end, "cases");
+    while (p && run->numCases < (int) NUM_BENCH_CASES)
+    {
+        const char *caseStart = strchr(p, '{');
+        if (!caseStart || caseStart >= casesEnd)
+            break;
+        const char *caseEnd = strchr(caseStart, '}');
+        if (!caseEnd)
+            break;
+
+        BenchResult *result = &run->cases[run->numCases];
+        const char *name  = findJsonKey(caseStart, caseEnd, "name");
+        const char *depth = findJsonKey(caseStart, caseEnd, "depth");
+        const char *nodes = findJsonKey(caseStart, caseEnd, "nodes");
+        if (depth && nodes && readJsonString(name, result->name))
+        {
+            result->depth    = atoi(depth);
+            result->nodes    = strtoull(nodes, NULL, 10);
+            result->numTimes = readJsonTimes(findJsonKey(caseStart, caseEnd, "seconds"), caseEnd, result->seconds);
+            if (result->numTimes)
+                run->numCases++;
+        }
+        p = caseEnd + 1;
+    }
+
+    strcpy(run->total.name, "total");
+    p = findJsonKey(json, end, "totalNodes");
+    if (p)
+        run->total.nodes = strtoull(p, NULL, 10);
+    run->total.numTimes = readJsonTimes(findJsonKey(json, end, "totalSeconds"), end, run->total.seconds);
+
+    free(json);
+
+    if (!run->numCases || !run->total.numTimes)
+    {
+        printf("\n%s isn't a bench result\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+static double medianOf(const double *values, int n)
+{
+    double sorted[BENCH_MAX_REPEATS];
+    memcpy(sorted, values, n * sizeof(double));
+    for (int i = 1; i < n; i++)
+        for (int j = i; j > 0 && sorted[j] < sorted[j - 1]; j--)
+        {
+            double t = sorted[j];
+            sorted[j] = sorted[j - 1];
+            sorted[j - 1] = t;
+        }
+    return (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// 95% interval of median(new) / median(base) (of the times, > 1 is slower), from resampling both sets of repeats
+static void bootstrapTimeRatio(BenchResult *base, BenchResult *cur, double *low, double *high)
+{
+    static double ratios[BENCH_BOOTSTRAP_SAMPLES];
+    double baseSample[BENCH_MAX_REPEATS], curSample[BENCH_MAX_REPEATS];
+
+    // fixed seed: the same two files always give the same answer
+    uint64 rng = 0x9E3779B97F4A7C15ull;
+    for (int s = 0; s < BENCH_BOOTSTRAP_SAMPLES; s++)
+    {
+        for (int i = 0; i < base->numTimes; i++)
+        {
+            rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+            baseSample[i] = base->seconds[rng % base->numTimes];
+        }
+        for (int i = 0; i < cur->numTimes; i++)
+        {
+            rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+            curSample[i] = cur->seconds[rng % cur->numTimes];
+        }
+        ratios[s] = medianOf(curSample, cur->numTimes) / medianOf(baseSample, base->numTimes);
+    }
+    qsort(ratios, BENCH_BOOTSTRAP_SAMPLES, sizeof(double), compareDoubles);
+    *low  = ratios[BENCH_BOOTSTRAP_SAMPLES * 25 / 1000];
+    *high = ratios[BENCH_BOOTSTRAP_SAMPLES * 975 / 1000 - 1];
+}
+
+// prints one line, returns true for a regression
+static bool compareBenchResult(BenchResult *base, BenchResult *cur, double threshold)
+{
+    double baseMedian = medianOf(base->seconds, base->numTimes);
+    double curMedian  = medianOf(cur->seconds, cur->numTimes);
+    double ratio = curMedian / baseMedian;
+    double low = ratio, high = ratio;
+    if (base->numTimes > 1 && cur->numTimes > 1)
+        bootstrapTimeRatio(base, cur, &low, &high);
+
+    bool slower = low  > 1.0 && ratio > 1.0 + threshold;
+    bool faster = high < 1.0 && ratio < 1.0 - threshold;
+
+    char label[64];
+    if (base->depth)
+        sprintf(label, "%s (%d)", base->name, base->depth);
+    else
+        sprintf(label, "%s", base->name);
+
+    // in nps: + is faster
+    printf("%-16s %12llu %12llu %+7.2f%%   [%+7.2f%%, %+7.2f%%]  %s\n", label,
+           (uint64) (base->nodes / baseMedian), (uint64) (cur->nodes / curMedian),
+           (1 / ratio - 1) * 100, (1 / high - 1) * 100, (1 / low - 1) * 100,
+           slower ? "SLOWER" : faster ? "faster" : "");
+
+    return slower;
+}
+
+int compareBench(const char *baseFile, const char *curFile, double thresholdPercent)
+{
+    static BenchRun base, cur;
+    if (!readBenchRun(baseFile, &base) || !readBenchRun(curFile, &cur))
+        return 2;
+
+    if (base.suiteVersion != cur.suiteVersion)
+    {
+        printf("\nbench suite versions differ (%d and %d), not comparable\n", base.suiteVersion, cur.suiteVersion);
+        return 2;
+    }
+
+    double threshold = thresholdPercent / 100.0;
+    printf("\n%s (%d repeats) -> %s (%d repeats), threshold %g%%\n", baseFile, base.total.numTimes, curFile, cur.total.numTimes,
+           thresholdPercent);
+
+    // (still compared: A/B of the variants is one of the uses)
+    if (base.hashTables >= 0 && cur.hashTables >= 0 &&
+        (strcmp(base.variant, cur.variant) != 0 || base.hashTables != cur.hashTables))
+        printf("different engine variants: %s (%s hash tables) -> %s (%s hash tables)\n", base.variant,
+               base.hashTables ? "with" : "no", cur.variant, cur.hashTables ? "with" : "no");
+    printf("\ncase               median nps   median nps   change   95%% interval\n");
+
+    int numSlower = 0;
+    for (int i = 0; i < base.numCases; i++)
+    {
+        BenchResult *baseCase = &base.cases[i];
+        BenchResult *curCase = NULL;
+        for (int j = 0; j < cur.numCases; j++)
+            if (strcmp(cur.cases[j].name, baseCase->name) == 0 && cur.cases[j].depth == baseCase->depth)
+                curCase = &cur.cases[j];
+
+        if (!curCase)
+        {
+            printf("%-16s not in %s\n", baseCase->name, curFile);
+            continue;
+        }
+        numSlower += compareBenchResult(baseCase, curCase, threshold);
+    }
+    numSlower += compareBenchResult(&base.total, &cur.total, threshold);
+
+    if (numSlower)
+        printf("\n%d regression(s)\n", numSlower);
+    return numSlower ? 1 : 0;
+}
+
+#endif
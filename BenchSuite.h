@@ -0,0 +1,415 @@
+#ifndef BENCH_SUITE_H
+#define BENCH_SUITE_H
+
+// "perft bench [repeats] [json file]": perft of a fixed set of positions with known counts
+// the suite is run 'repeats' times (with empty hash tables for every case), per case and total nps are printed and
+// written to the json file (bench.json by default) along with the build setup. Returns non zero if any count is wrong
+//
+// the cases (and BENCH_SUITE_VERSION) must only change together: numbers from different versions aren't comparable
+//
+// "perft variants [repeats]": the same suite with every engine variant in the build (see PerftVariants.h)
+// "perft tiers [repeats]": the same suite with every cpu tier the cpu supports (see CpuFeatures.h)
+// "perft backends [threads]": the same suite once with every slider backend, on 1 thread and then on 'threads'
+// threads all running it at once (to see how the tables of each backend share L2/L3)
+//
+// included by perft.cpp (needs START_TIMER/STOP_TIMER)
+
+#define BENCH_SUITE_VERSION     1
+#define BENCH_DEFAULT_REPEATS   3
+#define BENCH_DEFAULT_FILE      "bench.json"
+#define BENCH_MAX_REPEATS       100
+
+// positions from http://chessprogramming.wikispaces.com/Perft+Results
+// (counts of the last two were checked against the 0x88 generator)
+struct BenchCase
+{
+    const char *name;
+    const char *fen;
+    int         depth;
+    uint64      expected;
+};
+
+static BenchCase benchCases[] =
+{
+    { "start",      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",             6,  119060324ull },
+    { "kiwipete",   "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",     5,  193690690ull },
+    { "position3",  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                                7,  178633661ull },
+    { "position4",  "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",     6,  706045033ull },
+    { "position4m", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",     6,  706045033ull },
+    { "position5",  "rnbqkb1r/pp1p1ppp/2p5/4P3/2B5/8/PPP1NnPP/RNBQK2R w KQkq - 0 6",        5,   70202861ull },
+    { "218moves",   "3Q4/1Q4Q1/4Q3/2Q4R/Q4Q2/3Q4/1Q4Rp/1K1BBNNk w - - 0 1",                 6,   24376626ull },
+    { "enpassant",  "3k4/8/8/K1Pp3r/8/8/8/8 w - d6 0 1",                                    8,  107011259ull },
+};
+
+#define NUM_BENCH_CASES (sizeof(benchCases) / sizeof(benchCases[0]))
+
+uint64 runBenchCase(BenchCase *benchCase, bool clearHash = true)
+{
+    BoardPosition testBoard;
+    HexaBitBoardPosition testBB;
+    Utils::readFENString((char *) benchCase->fen, &testBoard);
+    Utils::board088ToHexBB(&testBB, &testBoard);
+
+    uint64 zobristHash = 0;
+#if INCREMENTAL_ZOBRIST_UPDATE == 1
+    zobristHash = computeZobristKey(&testBB);
+#endif
+
+    // so that the time doesn't depend on the order of the cases or on the repeat
+    if (clearHash && (perftVariantFlags(g_perftVariant) & VARIANT_FLAG_TT))
+        clearTT();
+
+#if USE_INTERLEAVED_PERFT == 1
+    return perft_interleaved(&testBB, benchCase->depth);
+#else
+    return perft_bb(&testBB, zobristHash, benchCase->depth);
+#endif
+}
+
+static void writeBenchJsonTimes(FILE *fp, double *ms, int repeats)
+{
+    fprintf(fp, "[");
+    for (int r = 0; r < repeats; r++)
+        fprintf(fp, "%s%.6f", r ? ", " : "", ms[r] / 1000.0);
+    fprintf(fp, "]");
+}
+
+// the build options that change the speed
+// (the engine variant and its hash table setup as selected at runtime, not the build switches: the hash table
+// variants are in every build)
+static void writeBenchJsonBuild(FILE *fp)
+{
+    uint32 flags = perftVariantFlags(g_perftVariant);
+
+    fprintf(fp, "  \"build\": {\n");
+    fprintf(fp, "    \"cpuTier\": \"%s\",\n", cpuTierNames[g_cpuTier]);
+    fprintf(fp, "    \"sliderBackend\": \"%s\",\n", sliderBackendNames[g_sliderBackend]);
+    fprintf(fp, "    \"variant\": \"%s\",\n", perftVariantNames[g_perftVariant]);
+    fprintf(fp, "    \"moveList\": %d,\n", (flags & VARIANT_FLAG_MOVE_LIST) != 0);
+    fprintf(fp, "    \"countOnly\": %d,\n", (flags & VARIANT_FLAG_COUNT_ONLY) != 0);
+    fprintf(fp, "    \"fixedDepth\": %d,\n", (flags & VARIANT_FLAG_FIXED_DEPTH) != 0);
+    fprintf(fp, "    \"USE_TEMPLATE_CHANCE_OPT\": %d,\n", USE_TEMPLATE_CHANCE_OPT);
+    fprintf(fp, "    \"EN_PASSENT_GENERATION_NEW_METHOD\": %d,\n", EN_PASSENT_GENERATION_NEW_METHOD);
+    fprintf(fp, "    \"hashTables\": %d", (flags & VARIANT_FLAG_TT) != 0);
+    if (flags & VARIANT_FLAG_TT)
+    {
+        fprintf(fp, ",\n    \"TT_BITS\": %d,\n", TT_BITS);
+        fprintf(fp, "    \"dualSlot\": %d,\n", (flags & VARIANT_FLAG_DUAL_SLOT) != 0);
+        fprintf(fp, "    \"shallowTT\": %d,\n", (flags & VARIANT_FLAG_SHALLOW_TT) != 0);
+#if USE_SHALLOW_TT == 1
+        if (flags & VARIANT_FLAG_SHALLOW_TT)
+            fprintf(fp, "    \"SHALLOW_TT_BITS\": %d,\n", SHALLOW_TT_BITS);
+#endif
+        fprintf(fp, "    \"USE_TT_CACHE\": %d,\n", USE_TT_CACHE);
+        fprintf(fp, "    \"USE_ADAPTIVE_TT\": %d,\n", USE_ADAPTIVE_TT);
+        // (only the default variant runs in the interleaved driver, see runBenchCase)
+#if USE_INTERLEAVED_PERFT == 1
+        fprintf(fp, "    \"interleaved\": %d", g_perftVariant == PERFT_VARIANT_DEFAULT);
+#else
+        fprintf(fp, "    \"interleaved\": 0");
+#endif
+    }
+    fprintf(fp, "\n  },\n");
+}
+
+int runBench(int repeats, const char *jsonFile)
+{
+    static double caseTime[NUM_BENCH_CASES][BENCH_MAX_REPEATS];     // ms
+    static uint64 caseNodes[NUM_BENCH_CASES];
+
+    if (repeats < 1 || repeats > BENCH_MAX_REPEATS)
+        repeats = BENCH_DEFAULT_REPEATS;
+
+    printf("\nbench suite version %d, %d repeats, using %s for sliding piece attacks, %s engine variant\n", BENCH_SUITE_VERSION,
+           repeats, sliderBackendNames[g_sliderBackend], perftVariantNames[g_perftVariant]);
+
+    // the whole suite once per repeat (rather than each case n times in a row), so that a slow phase of the box
+    // is spread over the cases instead of hitting all the repeats of one of them
+    for (int r = 0; r < repeats; r++)
+    {
+        for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        {
+            uint64 bbMoves;
+            START_TIMER
+            bbMoves = runBenchCase(&benchCases[i]);
+            STOP_TIMER
+
+            caseTime[i][r] = gTime;
+
+            // a count that changes between repeats is wrong too
+            if (r && bbMoves != caseNodes[i])
+                caseNodes[i] = 0;
+            else
+                caseNodes[i] = bbMoves;
+        }
+    }
+
+    int numWrong = 0;
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+    {
+        BenchCase *benchCase = &benchCases[i];
+        double bestTime = caseTime[i][0];
+        for (int r = 1; r < repeats; r++)
+            if (caseTime[i][r] < bestTime)
+                bestTime = caseTime[i][r];
+
+        bool wrong = caseNodes[i] != benchCase->expected;
+        numWrong += wrong;
+        printf("%-11s perft %d: %12llu, best of %d: %8.3g seconds, nps: %llu%s\n", benchCase->name, benchCase->depth, caseNodes[i],
+               repeats, bestTime / 1000.0, (uint64) ((caseNodes[i] / bestTime) * 1000.0), wrong ? "  (WRONG!)" : "");
+    }
+
+    // total of each repeat
+    double totalTime[BENCH_MAX_REPEATS];
+    uint64 totalNodes = 0;
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        totalNodes += caseNodes[i];
+
+    double bestTotal = 0;
+    for (int r = 0; r < repeats; r++)
+    {
+        totalTime[r] = 0;
+        for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+            totalTime[r] += caseTime[i][r];
+        if (r == 0 || totalTime[r] < bestTotal)
+            bestTotal = totalTime[r];
+    }
+    printf("total: %llu nodes, best of %d: %g seconds, nps: %llu\n", totalNodes, repeats, bestTotal / 1000.0,
+           (uint64) ((totalNodes / bestTotal) * 1000.0));
+
+    if (numWrong)
+        printf("\n%d of %d cases WRONG!\n", numWrong, (int) NUM_BENCH_CASES);
+
+    FILE *fp = fopen(jsonFile, "w");
+    if (!fp)
+    {
+        printf("\nFailed to create %s\n", jsonFile);
+        return 2;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"suiteVersion\": %d,\n", BENCH_SUITE_VERSION);
+    writeBenchJsonBuild(fp);
+    fprintf(fp, "  \"repeats\": %d,\n", repeats);
+    fprintf(fp, "  \"cases\": [\n");
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+    {
+        BenchCase *benchCase = &benchCases[i];
+        fprintf(fp, "    { \"name\": \"%s\", \"fen\": \"%s\", \"depth\": %d, \"expected\": %llu, \"nodes\": %llu, \"ok\": %s,\n",
+                benchCase->name, benchCase->fen, benchCase->depth, benchCase->expected, caseNodes[i],
+                caseNodes[i] == benchCase->expected ? "true" : "false");
+        fprintf(fp, "      \"seconds\": ");
+        writeBenchJsonTimes(fp, caseTime[i], repeats);
+        fprintf(fp, " }%s\n", i + 1 < (int) NUM_BENCH_CASES ? "," : "");
+    }
+    fprintf(fp, "  ],\n");
+    fprintf(fp, "  \"totalNodes\": %llu,\n", totalNodes);
+    fprintf(fp, "  \"totalSeconds\": ");
+    writeBenchJsonTimes(fp, totalTime, repeats);
+    fprintf(fp, ",\n");
+    fprintf(fp, "  \"bestNps\": %llu,\n", (uint64) ((totalNodes / bestTotal) * 1000.0));
+    fprintf(fp, "  \"ok\": %s\n", numWrong ? "false" : "true");
+    fprintf(fp, "}\n");
+    fclose(fp);
+
+    printf("\nresults written to %s\n", jsonFile);
+    return numWrong ? 1 : 0;
+}
+
+// total time of the suite with each engine variant, relative to the default one
+// returns non zero if any count is wrong
+int runVariantBench(int repeats)
+{
+    static double bestTotal[NUM_PERFT_VARIANTS];    // ms
+    static int    numWrong[NUM_PERFT_VARIANTS];
+
+    if (repeats < 1 || repeats > BENCH_MAX_REPEATS)
+        repeats = BENCH_DEFAULT_REPEATS;
+
+    printf("\nbench suite version %d with every engine variant, %d repeats, using %s for sliding piece attacks\n",
+           BENCH_SUITE_VERSION, repeats, sliderBackendNames[g_sliderBackend]);
+
+    int savedVariant = g_perftVariant;
+    uint64 totalNodes = 0;
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        totalNodes += benchCases[i].expected;
+
+    // all the variants once per repeat, same as the cases in runBench
+    for (int r = 0; r < repeats; r++)
+    {
+        for (int v = 0; v < NUM_PERFT_VARIANTS; v++)
+        {
+            if (!perftVariantAvailable(v))
+                continue;
+            setPerftVariant(v);
+
+            double total = 0;
+            for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+            {
+                uint64 bbMoves;
+                START_TIMER
+                bbMoves = runBenchCase(&benchCases[i]);
+                STOP_TIMER
+
+                total += gTime;
+                numWrong[v] += (bbMoves != benchCases[i].expected);
+            }
+            if (r == 0 || total < bestTotal[v])
+                bestTotal[v] = total;
+        }
+    }
+    setPerftVariant(savedVariant);
+
+    int anyWrong = 0;
+    printf("variant           best total (s)           nps   vs default\n");
+    for (int v = 0; v < NUM_PERFT_VARIANTS; v++)
+    {
+        if (!perftVariantAvailable(v))
+            continue;
+        anyWrong |= numWrong[v];
+        printf("%-16s  %14.3f  %12llu  %10.3f%s\n", perftVariantNames[v], bestTotal[v] / 1000.0,
+               (uint64) ((totalNodes / bestTotal[v]) * 1000.0), bestTotal[PERFT_VARIANT_DEFAULT] / bestTotal[v],
+               numWrong[v] ? "  (WRONG!)" : "");
+    }
+    return anyWrong ? 1 : 0;
+}
+
+// total time of the suite with each cpu tier up to the detected one, relative to the detected one
+// (the tiers below avx2 have no pext or simd passes: they run fancy magics instead)
+// returns non zero if any count is wrong
+int runTierBench(int repeats)
+{
+    static double bestTotal[NUM_CPU_TIERS];         // ms
+    static int    numWrong[NUM_CPU_TIERS];
+
+    if (repeats < 1 || repeats > BENCH_MAX_REPEATS)
+        repeats = BENCH_DEFAULT_REPEATS;
+
+    printf("\nbench suite version %d with every cpu tier, %d repeats, using %s for sliding piece attacks, %s engine variant\n",
+           BENCH_SUITE_VERSION, repeats, sliderBackendNames[g_sliderBackend], perftVariantNames[g_perftVariant]);
+
+    int savedTier = g_cpuTier;
+    uint64 totalNodes = 0;
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        totalNodes += benchCases[i].expected;
+
+    // all the tiers once per repeat, same as the cases in runBench
+    for (int r = 0; r < repeats; r++)
+    {
+        for (int t = CPU_TIER_GENERIC; t <= g_cpuTierDetected; t++)
+        {
+            setCpuTier(t);
+
+            double total = 0;
+            for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+            {
+                uint64 bbMoves;
+                START_TIMER
+                bbMoves = runBenchCase(&benchCases[i]);
+                STOP_TIMER
+
+                total += gTime;
+                numWrong[t] += (bbMoves != benchCases[i].expected);
+            }
+            if (r == 0 || total < bestTotal[t])
+                bestTotal[t] = total;
+        }
+    }
+    setCpuTier(savedTier);
+
+    int anyWrong = 0;
+    printf("tier       best total (s)           nps   vs %s\n", cpuTierNames[g_cpuTierDetected]);
+    for (int t = CPU_TIER_GENERIC; t <= g_cpuTierDetected; t++)
+    {
+        anyWrong |= numWrong[t];
+        printf("%-9s  %14.3f  %12llu  %10.3f%s\n", cpuTierNames[t], bestTotal[t] / 1000.0,
+               (uint64) ((totalNodes / bestTotal[t]) * 1000.0), bestTotal[g_cpuTierDetected] / bestTotal[t],
+               numWrong[t] ? "  (WRONG!)" : "");
+    }
+    return anyWrong ? 1 : 0;
+}
+
+// every thread runs the whole suite, so that all of them compete for the shared L2/L3
+// (the hash tables are shared: not cleared)
+static DWORD WINAPI backendBenchThread(LPVOID lpParam)
+{
+    uint64 *nodes = (uint64 *) lpParam;
+
+    *nodes = 0;
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        *nodes += runBenchCase(&benchCases[i], false);
+
+    return 0;
+}
+
+// nps of the suite with each slider backend, on 1 thread and on numThreads threads
+// returns non zero if any count is wrong
+int runBackendBench(int numThreads)
+{
+    if (numThreads < 1 || numThreads > MAX_THREADS)
+        numThreads = 1;
+
+    printf("\nbench suite version %d with every slider backend, %s engine variant\n", BENCH_SUITE_VERSION,
+           perftVariantNames[g_perftVariant]);
+
+    int savedBackend = g_sliderBackend;
+    int anyWrong = 0;
+    for (int backend = 0; backend < NUM_SLIDER_BACKENDS; backend++)
+    {
+        if (setSliderBackend(backend) != backend)
+            continue;
+
+        printf("\n%s:\n", sliderBackendNames[backend]);
+        uint64 totalNodes = 0;
+        double totalTime = 0;
+
+        for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        {
+            BenchCase *benchCase = &benchCases[i];
+            uint64 bbMoves;
+            START_TIMER
+            bbMoves = runBenchCase(benchCase);
+            STOP_TIMER
+
+            bool wrong = bbMoves != benchCase->expected;
+            anyWrong |= wrong;
+            printf("%-11s perft %d: %12llu, %8.3g seconds, nps: %llu%s\n", benchCase->name, benchCase->depth, bbMoves,
+                   gTime / 1000.0, (uint64) ((bbMoves / gTime) * 1000.0), wrong ? "  (WRONG!)" : "");
+
+            totalNodes += bbMoves;
+            totalTime  += gTime;
+        }
+        uint64 singleNps = (uint64) ((totalNodes / totalTime) * 1000.0);
+        printf("%s, 1 thread nps: %llu", sliderBackendNames[backend], singleNps);
+
+        if (numThreads > 1)
+        {
+            static uint64 threadNodes[MAX_THREADS];
+            static HANDLE benchThreads[MAX_THREADS];
+
+            START_TIMER
+            for (int i = 0; i < numThreads; i++)
+                benchThreads[i] = CreateThread(NULL, 0, backendBenchThread, &threadNodes[i], 0, NULL);
+            WaitForMultipleObjects(numThreads, benchThreads, TRUE, INFINITE);
+            STOP_TIMER
+
+            uint64 allNodes = 0;
+            for (int i = 0; i < numThreads; i++)
+            {
+                allNodes += threadNodes[i];
+                anyWrong |= threadNodes[i] != totalNodes;
+                CloseHandle(benchThreads[i]);
+            }
+            uint64 multiNps = (uint64) ((allNodes / gTime) * 1000.0);
+
+            // scaling of 1.0 means the threads didn't slow each other down at all
+            printf(", %d threads nps: %llu, scaling: %.3f", numThreads, multiNps, ((double) multiNps) / ((double) singleNps * numThreads));
+        }
+        printf("\n");
+    }
+
+    setSliderBackend(savedBackend);
+    return anyWrong ? 1 : 0;
+}
+
+#endif
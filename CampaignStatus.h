@@ -0,0 +1,193 @@
+#ifndef CAMPAIGN_STATUS_H
+#define CAMPAIGN_STATUS_H
+
+// progress of a verification mode run, for long campaigns
+// the main thread (which already wakes up every second to write the output records) prints a progress line every
+// PROGRESS_PRINT_INTERVAL seconds and rewrites <input file>.status.prom (prometheus text format) every
+// STATUS_FILE_INTERVAL seconds: records done, ETA, nodes/s per thread and (if the engine variant uses the hash tables)
+// the hash hit rates per depth from the node stats (NodeStats.h). On linux, SIGUSR1 makes it print the same metrics to stdout within a second
+// the worker threads only update their own counters in g_WorkUnit, all times are wall clock (QueryPerformanceCounter)
+//
+// included by perft.cpp (after g_WorkUnit)
+
+#include <signal.h>
+
+#define STATUS_FILE_INTERVAL        10      // seconds
+#define PROGRESS_PRINT_INTERVAL     60      // seconds
+
+static uint64 campaignStart;
+static uint64 campaignFreq;
+static volatile sig_atomic_t statusDumpRequested = 0;
+
+#ifndef _WIN32
+static void onStatusSignal(int)
+{
+    statusDumpRequested = 1;
+}
+#endif
+
+static uint64 campaignTicks()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static double campaignSeconds()
+{
+    return (double) (campaignTicks() - campaignStart) / campaignFreq;
+}
+
+// call before starting the threads
+void initCampaignStatus()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    campaignFreq  = frequency.QuadPart;
+    campaignStart = campaignTicks();
+#ifndef _WIN32
+    signal(SIGUSR1, onStatusSignal);
+#endif
+}
+
+static int campaignRecordsDone()
+{
+    int done = 0;
+    for (unsigned int i = 0; i < g_WorkUnit.numThreads; i++)
+        done += g_WorkUnit.recordsDone[i];
+    return done;
+}
+
+// seconds till all records are done at the rate so far, < 0 if not known yet
+static double campaignEta(double elapsed, int done)
+{
+    if (done == 0)
+        return -1;
+    return elapsed / done * (g_WorkUnit.totalRecords - done);
+}
+
+static void writeMetric(FILE *fp, const char *name, const char *type, const char *help)
+{
+    fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void writeCampaignMetrics(FILE *fp)
+{
+    double elapsed = campaignSeconds();
+    int done = campaignRecordsDone();
+    double eta = campaignEta(elapsed, done);
+
+    writeMetric(fp, "perft_records", "gauge", "Records in the work unit (not counting the ones done by earlier runs)");
+    fprintf(fp, "perft_records %u\n", g_WorkUnit.totalRecords);
+    writeMetric(fp, "perft_records_preprocessed", "gauge", "Records done by earlier runs");
+    fprintf(fp, "perft_records_preprocessed %u\n", g_WorkUnit.preProcessedRecords);
+    writeMetric(fp, "perft_records_done", "counter", "Records done by this run");
+    fprintf(fp, "perft_records_done %d\n", done);
+    writeMetric(fp, "perft_elapsed_seconds", "gauge", "Wall time since the threads were started");
+    fprintf(fp, "perft_elapsed_seconds %.1f\n", elapsed);
+    writeMetric(fp, "perft_eta_seconds", "gauge", "Estimated wall time till all records are done");
+    if (eta < 0)
+        fprintf(fp, "perft_eta_seconds NaN\n");
+    else
+        fprintf(fp, "perft_eta_seconds %.0f\n", eta);
+
+    writeMetric(fp, "perft_thread_records_done", "counter", "Records done by each thread");
+    for (unsigned int i = 0; i < g_WorkUnit.numThreads; i++)
+        fprintf(fp, "perft_thread_records_done{thread=\"%u\"} %d\n", i, g_WorkUnit.recordsDone[i]);
+    writeMetric(fp, "perft_thread_nodes_per_second", "gauge", "Perft nodes of the completed records of each thread per second");
+    uint64 totalNodes = 0;
+    for (unsigned int i = 0; i < g_WorkUnit.numThreads; i++)
+    {
+        totalNodes += g_WorkUnit.nodesDone[i];
+        fprintf(fp, "perft_thread_nodes_per_second{thread=\"%u\"} %.0f\n", i, elapsed > 0 ? g_WorkUnit.nodesDone[i] / elapsed : 0.0);
+    }
+    writeMetric(fp, "perft_nodes_per_second", "gauge", "Perft nodes of all completed records per second");
+    fprintf(fp, "perft_nodes_per_second %.0f\n", elapsed > 0 ? totalNodes / elapsed : 0.0);
+
+    // (the selected variant, not the build switch: the hash table variants are in every build)
+    if (!(perftVariantFlags(g_perftVariant) & VARIANT_FLAG_TT))
+        return;
+
+    // (read while the threads update them: a probe or two off at most)
+    writeMetric(fp, "perft_tt_probes", "counter", "Hash table probes per depth");
+    for (int depth = 0; depth < NODE_STATS_MAX_DEPTH; depth++)
+    {
+        uint64 probes = 0;
+        for (int t = 0; t < nodeStatsRegistry.size(); t++)
+        {
+            NodeStats *stats = nodeStatsRegistry.at(t);
+            if (stats)
+                probes += stats->ttProbes[depth];
+        }
+        if (probes)
+            fprintf(fp, "perft_tt_probes{depth=\"%d\"} %llu\n", depth, probes);
+    }
+    writeMetric(fp, "perft_tt_hit_ratio", "gauge", "Hash table hits per probe per depth");
+    for (int depth = 0; depth < NODE_STATS_MAX_DEPTH; depth++)
+    {
+        uint64 probes = 0, hits = 0;
+        for (int t = 0; t < nodeStatsRegistry.size(); t++)
+        {
+            NodeStats *stats = nodeStatsRegistry.at(t);
+            if (!stats)
+                continue;
+            probes += stats->ttProbes[depth];
+            hits   += stats->ttHits[depth];
+        }
+        if (probes)
+            fprintf(fp, "perft_tt_hit_ratio{depth=\"%d\"} %.4f\n", depth, (double) hits / probes);
+    }
+}
+
+// written to a temp file first, so that a reader never sees half a file
+bool writeStatusFile(const char *fileName)
+{
+    char tempName[1024];
+    sprintf(tempName, "%s.tmp", fileName);
+    FILE *fp = fopen(tempName, "w");
+    if (!fp)
+        return false;
+    writeCampaignMetrics(fp);
+    fclose(fp);
+#ifdef _WIN32
+    return MoveFileExA(tempName, fileName, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(tempName, fileName) == 0;
+#endif
+}
+
+void printCampaignProgress()
+{
+    double elapsed = campaignSeconds();
+    int done = campaignRecordsDone();
+    double eta = campaignEta(elapsed, done);
+    uint64 totalNodes = 0;
+    for (unsigned int i = 0; i < g_WorkUnit.numThreads; i++)
+        totalNodes += g_WorkUnit.nodesDone[i];
+
+    printf("\nRecords done: %d of %u (+%u earlier), %g seconds, avg: %g seconds per record, nps: %llu",
+           done, g_WorkUnit.totalRecords, g_WorkUnit.preProcessedRecords, elapsed, done ? elapsed / done : 0.0,
+           (uint64) (elapsed > 0 ? totalNodes / elapsed : 0));
+    if (eta >= 0)
+        printf(", ETA: %.0f seconds", eta);
+    printf("\n");
+    fflush(stdout);
+}
+
+// from the main thread's once a second loop
+void updateCampaignStatus(const char *statusFile, int seconds)
+{
+    if (seconds % PROGRESS_PRINT_INTERVAL == 0)
+        printCampaignProgress();
+    if (seconds % STATUS_FILE_INTERVAL == 0)
+        writeStatusFile(statusFile);
+    if (statusDumpRequested)
+    {
+        statusDumpRequested = 0;
+        printf("\n");
+        writeCampaignMetrics(stdout);
+        fflush(stdout);
+    }
+}
+
+#endif
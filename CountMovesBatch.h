@@ -0,0 +1,444 @@
+#ifndef COUNT_MOVES_BATCH_H
+#define COUNT_MOVES_BATCH_H
+
+// counts the legal moves of several positions at once, one position per simd lane
+// (4 positions with avx2, 8 with avx-512)
+//
+// meant for the leaf-parent level of perft: generateBoards() writes all child boards of a position
+// contiguously and all of them have the same side to move, so they can be counted in batches
+// the boards are gathered into structure of arrays form (one vector per bitboard) and everything is
+// computed with shifts and kogge-stone fills in all 8 directions:
+//  - moves of sliders are counted per direction. In a given direction no two sliders can reach the same
+//    square (the nearer one blocks the other), so popcount of the fill of all sliders of the side is exact
+//  - knights are counted per jump direction for the same reason
+//  - a pinned piece is allowed to move only in the direction of the pin (or the opposite one)
+//
+// lanes where the king is in check or en-passent is possible are rare and are counted by the scalar
+// countMoves() instead (see countMovesBatch at the end of this file)
+// only the kogge-stone simd backend counts this way (SLIDER_KOGGE_STONE_SIMD), with the other backends
+// countMovesBatch is just the countMoves() loop, so that they are measured on their own code
+
+#include "chess.h"
+#include <intrin.h>
+
+#if !defined(__CUDA_ARCH__) && defined(_WIN64)
+
+// ---------------------------------------- simd primitives ----------------------------------------
+
+// popcount of every 64 bit lane: popcount of nibbles with pshufb, summed per lane using psadbw
+// (avx-512 vpopcntq needs ice lake or later so isn't part of the avx512 tier)
+
+struct SimdAvx2
+{
+    typedef __m256i V;
+    enum { WIDTH = 4 };
+
+    static MY_INLINE V set1(uint64 x)           { return _mm256_set1_epi64x(x); }
+    static MY_INLINE V zero()                   { return _mm256_setzero_si256(); }
+    static MY_INLINE V and_(V a, V b)           { return _mm256_and_si256(a, b); }
+    static MY_INLINE V or_(V a, V b)            { return _mm256_or_si256(a, b); }
+    static MY_INLINE V andNot(V a, V b)         { return _mm256_andnot_si256(a, b); }  // ~a & b
+    static MY_INLINE V add(V a, V b)            { return _mm256_add_epi64(a, b); }
+    static MY_INLINE V shl(V a, int n)          { return _mm256_slli_epi64(a, n); }
+    static MY_INLINE V shr(V a, int n)          { return _mm256_srli_epi64(a, n); }
+
+    // all ones in lanes where a is zero
+    static MY_INLINE V isZero(V a)              { return _mm256_cmpeq_epi64(a, zero()); }
+    static MY_INLINE V nonZero(V a)             { return _mm256_xor_si256(isZero(a), _mm256_set1_epi64x(-1)); }
+
+    // bit i set if lane i is all ones (for vectors from isZero/nonZero)
+    static MY_INLINE uint32 laneMask(V a)       { return _mm256_movemask_pd(_mm256_castsi256_pd(a)); }
+
+    // field at the given byte offset of WIDTH consecutive positions
+    static MY_INLINE V gather(const HexaBitBoardPosition *pos, int offset)
+    {
+        const int size = sizeof(HexaBitBoardPosition);
+        const __m256i index = _mm256_setr_epi64x(0, size, 2 * size, 3 * size);
+        return _mm256_i64gather_epi64((const long long *) (((const uint8 *) pos) + offset), index, 1);
+    }
+
+    static MY_INLINE V popCount(V a)
+    {
+        const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowNibbles   = _mm256_set1_epi8(0x0F);
+        __m256i lo = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(a, lowNibbles));
+        __m256i hi = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi64(a, 4), lowNibbles));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero());
+    }
+
+    static MY_INLINE uint64 horizontalSum(V a)
+    {
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+        return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+    }
+};
+
+struct SimdAvx512
+{
+    typedef __m512i V;
+    enum { WIDTH = 8 };
+
+    static MY_INLINE V set1(uint64 x)           { return _mm512_set1_epi64(x); }
+    static MY_INLINE V zero()                   { return _mm512_setzero_si512(); }
+    static MY_INLINE V and_(V a, V b)           { return _mm512_and_si512(a, b); }
+    static MY_INLINE V or_(V a, V b)            { return _mm512_or_si512(a, b); }
+    static MY_INLINE V andNot(V a, V b)         { return _mm512_andnot_si512(a, b); }
+    static MY_INLINE V add(V a, V b)            { return _mm512_add_epi64(a, b); }
+    static MY_INLINE V shl(V a, int n)          { return _mm512_slli_epi64(a, n); }
+    static MY_INLINE V shr(V a, int n)          { return _mm512_srli_epi64(a, n); }
+
+    static MY_INLINE V isZero(V a)              { return _mm512_movm_epi64(_mm512_testn_epi64_mask(a, a)); }
+    static MY_INLINE V nonZero(V a)             { return _mm512_movm_epi64(_mm512_test_epi64_mask(a, a)); }
+    static MY_INLINE uint32 laneMask(V a)       { return _mm512_movepi64_mask(a); }
+
+    static MY_INLINE V gather(const HexaBitBoardPosition *pos, int offset)
+    {
+        const int size = sizeof(HexaBitBoardPosition);
+        const __m512i index = _mm512_setr_epi64(0, size, 2 * size, 3 * size, 4 * size, 5 * size, 6 * size, 7 * size);
+        return _mm512_i64gather_epi64(index, ((const uint8 *) pos) + offset, 1);
+    }
+
+    static MY_INLINE V popCount(V a)
+    {
+        const __m512i nibbleCounts = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+        const __m512i lowNibbles   = _mm512_set1_epi8(0x0F);
+        __m512i lo = _mm512_shuffle_epi8(nibbleCounts, _mm512_and_si512(a, lowNibbles));
+        __m512i hi = _mm512_shuffle_epi8(nibbleCounts, _mm512_and_si512(_mm512_srli_epi64(a, 4), lowNibbles));
+        return _mm512_sad_epu8(_mm512_add_epi8(lo, hi), zero());
+    }
+
+    static MY_INLINE uint64 horizontalSum(V a)  { return _mm512_reduce_add_epi64(a); }
+};
+
+
+// ------------------------------------------- directions -------------------------------------------
+
+// a direction is a shift (left for positive, right for negative) and the squares that don't wrap around the board
+#define BATCH_NORTH         8, ALLSET
+#define BATCH_SOUTH        -8, ALLSET
+#define BATCH_EAST          1, (~FILEA)
+#define BATCH_WEST         -1, (~FILEH)
+#define BATCH_NORTH_EAST    9, (~FILEA)
+#define BATCH_NORTH_WEST    7, (~FILEH)
+#define BATCH_SOUTH_EAST   -7, (~FILEA)
+#define BATCH_SOUTH_WEST   -9, (~FILEH)
+
+template <class S, int shift>
+MY_INLINE static typename S::V batchShift(typename S::V a)
+{
+    return (shift > 0) ? S::shl(a, shift) : S::shr(a, -shift);
+}
+
+// one step in the given direction
+template <class S, int shift, uint64 avoidWrap>
+MY_INLINE static typename S::V batchOne(typename S::V a)
+{
+    typename S::V b = batchShift<S, shift>(a);
+    return (avoidWrap == ALLSET) ? b : S::and_(b, S::set1(avoidWrap));
+}
+
+// kogge-stone attacks in the given direction, pro - empty squares
+template <class S, int shift, uint64 avoidWrap>
+MY_INLINE static typename S::V batchAttacks(typename S::V gen, typename S::V pro)
+{
+    if (avoidWrap != ALLSET)
+        pro = S::and_(pro, S::set1(avoidWrap));
+
+    gen = S::or_(gen, S::and_(pro, batchShift<S, shift    >(gen)));
+    pro = S::and_(pro, batchShift<S, shift>(pro));
+    gen = S::or_(gen, S::and_(pro, batchShift<S, 2 * shift>(gen)));
+    pro = S::and_(pro, batchShift<S, 2 * shift>(pro));
+    gen = S::or_(gen, S::and_(pro, batchShift<S, 4 * shift>(gen)));
+
+    return batchOne<S, shift, avoidWrap>(gen);
+}
+
+
+// --------------------------------------------- kernel ---------------------------------------------
+
+// state shared by the steps of the kernel (one lane per position)
+template <class S>
+struct BatchBoards
+{
+    typename S::V allPieces, empty, myPieces, enemyPieces;
+    typename S::V myKing, myPawns, myKnights, myBishops, myRooks;
+    typename S::V enemyBishops, enemyRooks;
+    typename S::V threatened;
+    typename S::V pinned;
+};
+
+// pieces pinned in the given direction (seen from the king)
+template <class S, int shift, uint64 avoidWrap>
+MY_INLINE static typename S::V batchPinned(const BatchBoards<S> &b, typename S::V enemySliders)
+{
+    // first piece seen from the king, if it's ours
+    typename S::V blocker = S::and_(batchAttacks<S, shift, avoidWrap>(b.myKing, b.empty), b.myPieces);
+
+    // and the piece behind it, which pins it if it's an enemy slider moving in this direction
+    typename S::V pinner  = S::and_(batchAttacks<S, shift, avoidWrap>(b.myKing, S::or_(b.empty, blocker)), enemySliders);
+
+    return S::and_(S::nonZero(pinner), blocker);
+}
+
+// moves of our sliders in the given direction
+// (pinned sliders can only move along the pin, i.e, if pinned in this or the opposite direction)
+template <class S, int shift, uint64 avoidWrap>
+MY_INLINE static typename S::V batchSliderMoves(const BatchBoards<S> &b, typename S::V mySliders, typename S::V pinnedAlong)
+{
+    typename S::V movable = S::and_(mySliders, S::or_(S::andNot(b.pinned, S::set1(ALLSET)), pinnedAlong));
+    return S::popCount(S::andNot(b.myPieces, batchAttacks<S, shift, avoidWrap>(movable, b.empty)));
+}
+
+// knight moves for one of the 8 jumps
+template <class S, int shift, uint64 avoidWrap>
+MY_INLINE static typename S::V batchKnightJump(typename S::V knights, typename S::V notMine)
+{
+    return S::popCount(S::and_(batchOne<S, shift, avoidWrap>(knights), notMine));
+}
+
+template <class S>
+MY_INLINE static typename S::V batchKnightAttacks(typename S::V knights)
+{
+    typename S::V attacks;
+    attacks =                batchOne<S,  17, ~FILEA>(knights);
+    attacks = S::or_(attacks, batchOne<S,  15, ~FILEH>(knights));
+    attacks = S::or_(attacks, batchOne<S,  10, ~(FILEA | FILEB)>(knights));
+    attacks = S::or_(attacks, batchOne<S,   6, ~(FILEG | FILEH)>(knights));
+    attacks = S::or_(attacks, batchOne<S,  -6, ~(FILEA | FILEB)>(knights));
+    attacks = S::or_(attacks, batchOne<S, -10, ~(FILEG | FILEH)>(knights));
+    attacks = S::or_(attacks, batchOne<S, -15, ~FILEA>(knights));
+    attacks = S::or_(attacks, batchOne<S, -17, ~FILEH>(knights));
+    return attacks;
+}
+
+template <class S>
+MY_INLINE static typename S::V batchKingAttacks(typename S::V king)
+{
+    typename S::V attacks;
+    attacks =                batchOne<S, BATCH_NORTH>(king);
+    attacks = S::or_(attacks, batchOne<S, BATCH_SOUTH>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_EAST>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_WEST>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_NORTH_EAST>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_NORTH_WEST>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_SOUTH_EAST>(king));
+    attacks = S::or_(attacks, batchOne<S, BATCH_SOUTH_WEST>(king));
+    return attacks;
+}
+
+// no of moves + 3 extra for every promotion
+template <class S>
+MY_INLINE static typename S::V batchPawnMoveCount(typename S::V dsts)
+{
+    typename S::V promotions = S::popCount(S::and_(dsts, S::set1(RANK1 | RANK8)));
+    return S::add(S::popCount(dsts), S::add(promotions, S::add(promotions, promotions)));
+}
+
+// counts moves of S::WIDTH positions (all with the given side to move)
+// returns the total over all lanes that could be handled, lanes that need the scalar countMoves are set in *fallbackLanes
+template <class S, uint8 chance>
+static uint64 countMovesBatchKernel(const HexaBitBoardPosition *pos, uint32 *fallbackLanes)
+{
+    typedef typename S::V V;
+    BatchBoards<S> b;
+
+    // 1. gather the boards
+    V whitePieces  = S::gather(pos, offsetof(HexaBitBoardPosition, whitePieces));
+    V pawnsAndFlags= S::gather(pos, offsetof(HexaBitBoardPosition, pawns));
+    V knights      = S::gather(pos, offsetof(HexaBitBoardPosition, knights));
+    V bishopQueens = S::gather(pos, offsetof(HexaBitBoardPosition, bishopQueens));
+    V rookQueens   = S::gather(pos, offsetof(HexaBitBoardPosition, rookQueens));
+    V kings        = S::gather(pos, offsetof(HexaBitBoardPosition, kings));
+
+    V allPawns     = S::and_(pawnsAndFlags, S::set1(RANKS2TO7));
+    b.allPieces    = S::or_(S::or_(kings, allPawns), S::or_(knights, S::or_(bishopQueens, rookQueens)));
+    b.empty        = S::andNot(b.allPieces, S::set1(ALLSET));
+    V blackPieces  = S::andNot(whitePieces, b.allPieces);
+
+    b.myPieces     = (chance == WHITE) ? whitePieces : blackPieces;
+    b.enemyPieces  = (chance == WHITE) ? blackPieces : whitePieces;
+
+    b.myKing       = S::and_(kings,        b.myPieces);
+    b.myPawns      = S::and_(allPawns,     b.myPieces);
+    b.myKnights    = S::and_(knights,      b.myPieces);
+    b.myBishops    = S::and_(bishopQueens, b.myPieces);
+    b.myRooks      = S::and_(rookQueens,   b.myPieces);
+    b.enemyBishops = S::and_(bishopQueens, b.enemyPieces);
+    b.enemyRooks   = S::and_(rookQueens,   b.enemyPieces);
+
+    // 2. squares attacked by the enemy (squares behind our king are also attacked)
+    V enemyPawns   = S::and_(allPawns, b.enemyPieces);
+    if (chance == WHITE)
+        b.threatened = S::or_(batchOne<S, BATCH_SOUTH_EAST>(enemyPawns), batchOne<S, BATCH_SOUTH_WEST>(enemyPawns));
+    else
+        b.threatened = S::or_(batchOne<S, BATCH_NORTH_EAST>(enemyPawns), batchOne<S, BATCH_NORTH_WEST>(enemyPawns));
+
+    b.threatened = S::or_(b.threatened, batchKnightAttacks<S>(S::and_(knights, b.enemyPieces)));
+    b.threatened = S::or_(b.threatened, batchKingAttacks<S>(S::and_(kings, b.enemyPieces)));
+
+    V pro = S::or_(b.empty, b.myKing);
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_NORTH>(b.enemyRooks, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_SOUTH>(b.enemyRooks, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_EAST> (b.enemyRooks, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_WEST> (b.enemyRooks, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_NORTH_EAST>(b.enemyBishops, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_NORTH_WEST>(b.enemyBishops, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_SOUTH_EAST>(b.enemyBishops, pro));
+    b.threatened = S::or_(b.threatened, batchAttacks<S, BATCH_SOUTH_WEST>(b.enemyBishops, pro));
+
+    // lanes in check or with en-passent possible are left to the scalar code
+    V fallback = S::or_(S::nonZero(S::and_(b.threatened, b.myKing)),
+                        S::nonZero(S::and_(pawnsAndFlags, S::set1(0xF0))));    // enPassent field
+    *fallbackLanes = S::laneMask(fallback);
+
+    // 3. pinned pieces, for every direction
+    V pinnedN  = batchPinned<S, BATCH_NORTH>(b, b.enemyRooks);
+    V pinnedS  = batchPinned<S, BATCH_SOUTH>(b, b.enemyRooks);
+    V pinnedE  = batchPinned<S, BATCH_EAST> (b, b.enemyRooks);
+    V pinnedW  = batchPinned<S, BATCH_WEST> (b, b.enemyRooks);
+    V pinnedNE = batchPinned<S, BATCH_NORTH_EAST>(b, b.enemyBishops);
+    V pinnedNW = batchPinned<S, BATCH_NORTH_WEST>(b, b.enemyBishops);
+    V pinnedSE = batchPinned<S, BATCH_SOUTH_EAST>(b, b.enemyBishops);
+    V pinnedSW = batchPinned<S, BATCH_SOUTH_WEST>(b, b.enemyBishops);
+
+    V pinnedFile     = S::or_(pinnedN,  pinnedS);
+    V pinnedRank     = S::or_(pinnedE,  pinnedW);
+    V pinnedDiagonal = S::or_(pinnedNE, pinnedSW);     // a1-h8 direction
+    V pinnedAntiDiag = S::or_(pinnedNW, pinnedSE);     // h1-a8 direction
+    b.pinned = S::or_(S::or_(pinnedFile, pinnedRank), S::or_(pinnedDiagonal, pinnedAntiDiag));
+
+    // 4. count the moves
+    V notMine = S::andNot(b.myPieces, S::set1(ALLSET));
+    V count;
+
+    // king
+    count = S::popCount(S::andNot(S::or_(b.threatened, b.myPieces), batchKingAttacks<S>(b.myKing)));
+
+    // knights (pinned knights can't move)
+    V freeKnights = S::andNot(b.pinned, b.myKnights);
+    count = S::add(count, batchKnightJump<S,  17, ~FILEA>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S,  15, ~FILEH>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S,  10, ~(FILEA | FILEB)>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S,   6, ~(FILEG | FILEH)>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S,  -6, ~(FILEA | FILEB)>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S, -10, ~(FILEG | FILEH)>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S, -15, ~FILEA>(freeKnights, notMine));
+    count = S::add(count, batchKnightJump<S, -17, ~FILEH>(freeKnights, notMine));
+
+    // bishops, rooks and queens
+    count = S::add(count, batchSliderMoves<S, BATCH_NORTH>(b, b.myRooks, pinnedFile));
+    count = S::add(count, batchSliderMoves<S, BATCH_SOUTH>(b, b.myRooks, pinnedFile));
+    count = S::add(count, batchSliderMoves<S, BATCH_EAST> (b, b.myRooks, pinnedRank));
+    count = S::add(count, batchSliderMoves<S, BATCH_WEST> (b, b.myRooks, pinnedRank));
+    count = S::add(count, batchSliderMoves<S, BATCH_NORTH_EAST>(b, b.myBishops, pinnedDiagonal));
+    count = S::add(count, batchSliderMoves<S, BATCH_SOUTH_WEST>(b, b.myBishops, pinnedDiagonal));
+    count = S::add(count, batchSliderMoves<S, BATCH_NORTH_WEST>(b, b.myBishops, pinnedAntiDiag));
+    count = S::add(count, batchSliderMoves<S, BATCH_SOUTH_EAST>(b, b.myBishops, pinnedAntiDiag));
+
+    // pawns: pushes only if not pinned or pinned along the file,
+    // captures only if not pinned or pinned along the diagonal of the capture
+    V freePawns = S::andNot(b.pinned, b.myPawns);
+    V pushers   = S::or_(freePawns, S::and_(b.myPawns, pinnedFile));
+    V dsts;
+    if (chance == WHITE)
+    {
+        V westCapturers = S::or_(freePawns, S::and_(b.myPawns, pinnedAntiDiag));
+        V eastCapturers = S::or_(freePawns, S::and_(b.myPawns, pinnedDiagonal));
+
+        dsts  = S::and_(batchOne<S, BATCH_NORTH>(pushers), b.empty);
+        count = S::add(count, batchPawnMoveCount<S>(dsts));
+        dsts  = S::and_(batchOne<S, BATCH_NORTH>(S::and_(dsts, S::set1(RANK3))), b.empty);
+        count = S::add(count, S::popCount(dsts));
+
+        count = S::add(count, batchPawnMoveCount<S>(S::and_(batchOne<S, BATCH_NORTH_WEST>(westCapturers), b.enemyPieces)));
+        count = S::add(count, batchPawnMoveCount<S>(S::and_(batchOne<S, BATCH_NORTH_EAST>(eastCapturers), b.enemyPieces)));
+    }
+    else
+    {
+        V westCapturers = S::or_(freePawns, S::and_(b.myPawns, pinnedDiagonal));
+        V eastCapturers = S::or_(freePawns, S::and_(b.myPawns, pinnedAntiDiag));
+
+        dsts  = S::and_(batchOne<S, BATCH_SOUTH>(pushers), b.empty);
+        count = S::add(count, batchPawnMoveCount<S>(dsts));
+        dsts  = S::and_(batchOne<S, BATCH_SOUTH>(S::and_(dsts, S::set1(RANK6))), b.empty);
+        count = S::add(count, S::popCount(dsts));
+
+        count = S::add(count, batchPawnMoveCount<S>(S::and_(batchOne<S, BATCH_SOUTH_WEST>(westCapturers), b.enemyPieces)));
+        count = S::add(count, batchPawnMoveCount<S>(S::and_(batchOne<S, BATCH_SOUTH_EAST>(eastCapturers), b.enemyPieces)));
+    }
+
+    // castling (we know the king isn't in check)
+    V one = S::set1(1);
+    V kingSide, queenSide;
+    if (chance == WHITE)
+    {
+        kingSide  = S::and_(S::nonZero(S::and_(pawnsAndFlags, S::set1(CASTLE_FLAG_KING_SIDE))),
+                            S::isZero(S::and_(S::or_(b.allPieces, b.threatened), S::set1(F1G1))));
+        queenSide = S::and_(S::nonZero(S::and_(pawnsAndFlags, S::set1(CASTLE_FLAG_QUEEN_SIDE))),
+                            S::isZero(S::or_(S::and_(b.allPieces, S::set1(B1D1)), S::and_(b.threatened, S::set1(C1D1)))));
+    }
+    else
+    {
+        kingSide  = S::and_(S::nonZero(S::and_(pawnsAndFlags, S::set1(CASTLE_FLAG_KING_SIDE  << 2))),
+                            S::isZero(S::and_(S::or_(b.allPieces, b.threatened), S::set1(F8G8))));
+        queenSide = S::and_(S::nonZero(S::and_(pawnsAndFlags, S::set1(CASTLE_FLAG_QUEEN_SIDE << 2))),
+                            S::isZero(S::or_(S::and_(b.allPieces, S::set1(B8D8)), S::and_(b.threatened, S::set1(C8D8)))));
+    }
+    count = S::add(count, S::add(S::and_(kingSide, one), S::and_(queenSide, one)));
+
+    return S::horizontalSum(S::andNot(fallback, count));
+}
+
+template <class S, uint8 chance, int cpuTier, int sliderBackend>
+static uint64 countMovesBatchSimd(HexaBitBoardPosition *pos, uint32 nPos)
+{
+    uint64 count = 0;
+    uint32 i = 0;
+    for (; i + S::WIDTH <= nPos; i += S::WIDTH)
+    {
+        uint32 fallbackLanes;
+        count += countMovesBatchKernel<S, chance>(&pos[i], &fallbackLanes);
+        while (fallbackLanes)
+        {
+            uint32 lane = bitScan(fallbackLanes);
+            count += countMoves<cpuTier, sliderBackend>(&pos[i + lane]);
+            fallbackLanes &= fallbackLanes - 1;
+        }
+    }
+
+    // remaining positions
+    for (; i < nPos; i++)
+        count += countMoves<cpuTier, sliderBackend>(&pos[i]);
+
+    return count;
+}
+
+#endif // #if !defined(__CUDA_ARCH__) && defined(_WIN64)
+
+// total of countMoves() of the given positions, all of which must have the same side to move
+// (e.g, all the children of a position)
+template <int cpuTier, int sliderBackend>
+uint64 countMovesBatch(HexaBitBoardPosition *pos, uint32 nPos)
+{
+#if USE_BATCHED_LEAF_COUNT == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+    if (cpuTier >= CPU_TIER_AVX2 && sliderBackend == SLIDER_KOGGE_STONE_SIMD && nPos)
+    {
+        if (cpuTier >= CPU_TIER_AVX512)
+        {
+            return (pos->chance == WHITE) ? countMovesBatchSimd<SimdAvx512, WHITE, cpuTier, sliderBackend>(pos, nPos) :
+                                            countMovesBatchSimd<SimdAvx512, BLACK, cpuTier, sliderBackend>(pos, nPos);
+        }
+        return (pos->chance == WHITE) ? countMovesBatchSimd<SimdAvx2, WHITE, cpuTier, sliderBackend>(pos, nPos) :
+                                        countMovesBatchSimd<SimdAvx2, BLACK, cpuTier, sliderBackend>(pos, nPos);
+    }
+#endif
+
+    uint64 count = 0;
+    for (uint32 i = 0; i < nPos; i++)
+        count += countMoves<cpuTier, sliderBackend>(&pos[i]);
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// run time detection of the instruction set extensions the bitboard move generator can make use of
+// the generator hot path is instantiated once per 'tier' (see MoveGeneratorBitboardT) and
+// perft_bb() picks the fastest instantiation the cpu we are running on supports
+// (this replaces the separate popcnt/no_popcnt binaries we used to ship)
+
+#include "chess.h"
+#include <intrin.h>
+
+// individual features
+#define CPU_FEATURE_POPCNT      BIT(0)
+#define CPU_FEATURE_LZCNT       BIT(1)
+#define CPU_FEATURE_BMI1        BIT(2)
+#define CPU_FEATURE_BMI2        BIT(3)
+#define CPU_FEATURE_AVX         BIT(4)      // (includes OS support for saving ymm registers)
+#define CPU_FEATURE_AVX2        BIT(5)
+#define CPU_FEATURE_AVX512F     BIT(6)      // (includes OS support for saving zmm registers)
+#define CPU_FEATURE_AVX512BW    BIT(7)
+#define CPU_FEATURE_AVX512DQ    BIT(8)
+#define CPU_FEATURE_AVX512VL    BIT(9)
+#define CPU_FEATURE_FAST_PEXT   BIT(10)     // BMI2 with pext/pdep done in hardware (microcoded and very slow on AMD before zen 3)
+
+// feature tiers the generator is instantiated for
+// every tier includes all the features of the tiers below it
+#define CPU_TIER_GENERIC        0   // any x64 cpu (e.g, core 2): software popcount
+#define CPU_TIER_POPCNT         1   // nehalem and later: popcnt instruction
+#define CPU_TIER_AVX2           2   // haswell and later: BMI1, BMI2, LZCNT and AVX2
+#define CPU_TIER_AVX512         3   // skylake-x and later: AVX-512 F/BW/DQ/VL
+#define NUM_CPU_TIERS           4
+
+#define CPU_TIER_AVX2_FEATURES   (CPU_FEATURE_POPCNT | CPU_FEATURE_LZCNT | CPU_FEATURE_BMI1 | CPU_FEATURE_BMI2 | \
+                                  CPU_FEATURE_AVX    | CPU_FEATURE_AVX2)
+#define CPU_TIER_AVX512_FEATURES (CPU_TIER_AVX2_FEATURES | CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512BW | \
+                                  CPU_FEATURE_AVX512DQ   | CPU_FEATURE_AVX512VL)
+
+static const char *cpuTierNames[NUM_CPU_TIERS] = { "generic", "popcnt", "avx2", "avx512" };
+
+// features supported by the cpu and the tier selected for it (filled in by detectCpuFeatures)
+static uint32 g_cpuFeatures     = 0;
+static int    g_cpuTierDetected = CPU_TIER_GENERIC;
+
+// the tier actually in use (can be lowered for testing, but never raised above g_cpuTierDetected)
+static int    g_cpuTier         = CPU_TIER_GENERIC;
+
+uint32 readCpuFeatures()
+{
+    uint32 features = 0;
+    int info[4];    // eax, ebx, ecx, edx
+
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    bool isAmd = info[1] == 0x68747541 && info[3] == 0x69746e65 && info[2] == 0x444d4163;   // "AuthenticAMD"
+    int family = 0;
+
+    __cpuid(info, 0x80000000);
+    uint32 maxExtLeaf = (uint32) info[0];
+
+    bool osSavesYmm = false;
+    bool osSavesZmm = false;
+
+    if (maxLeaf >= 1)
+    {
+        __cpuid(info, 1);
+        family = (info[0] >> 8) & 0xF;
+        if (family == 0xF)
+            family += (info[0] >> 20) & 0xFF;
+
+        if (info[2] & BIT(23))
+            features |= CPU_FEATURE_POPCNT;
+
+        // AVX needs both cpu support and the OS saving the upper halves of the registers (XSAVE enabled)
+        if ((info[2] & BIT(27)) && (info[2] & BIT(28)))
+        {
+            uint64 xcr0 = _xgetbv(0);
+            osSavesYmm = (xcr0 & 0x06) == 0x06;    // xmm and ymm state
+            osSavesZmm = (xcr0 & 0xE6) == 0xE6;    // also opmask and both halves of zmm state
+            if (osSavesYmm)
+                features |= CPU_FEATURE_AVX;
+        }
+    }
+
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        if (info[1] & BIT(3))
+            features |= CPU_FEATURE_BMI1;
+        if (info[1] & BIT(8))
+        {
+            features |= CPU_FEATURE_BMI2;
+            if (!isAmd || family >= 0x19)
+                features |= CPU_FEATURE_FAST_PEXT;
+        }
+        if ((info[1] & BIT(5)) && osSavesYmm)
+            features |= CPU_FEATURE_AVX2;
+
+        if (osSavesZmm)
+        {
+            if (info[1] & BIT(16))
+                features |= CPU_FEATURE_AVX512F;
+            if (info[1] & BIT(17))
+                features |= CPU_FEATURE_AVX512DQ;
+            if (info[1] & BIT(30))
+                features |= CPU_FEATURE_AVX512BW;
+            if (info[1] & BIT(31))
+                features |= CPU_FEATURE_AVX512VL;
+        }
+    }
+
+    if (maxExtLeaf >= 0x80000001)
+    {
+        __cpuid(info, 0x80000001);
+        if (info[2] & BIT(5))
+            features |= CPU_FEATURE_LZCNT;
+    }
+
+    return features;
+}
+
+int cpuTierForFeatures(uint32 features)
+{
+    if ((features & CPU_TIER_AVX512_FEATURES) == CPU_TIER_AVX512_FEATURES)
+        return CPU_TIER_AVX512;
+
+    if ((features & CPU_TIER_AVX2_FEATURES) == CPU_TIER_AVX2_FEATURES)
+        return CPU_TIER_AVX2;
+
+    if (features & CPU_FEATURE_POPCNT)
+        return CPU_TIER_POPCNT;
+
+    return CPU_TIER_GENERIC;
+}
+
+// lower (or restore) the tier used by perft_bb, returns the tier actually selected
+int setCpuTier(int tier)
+{
+    if (tier < CPU_TIER_GENERIC)
+        tier = CPU_TIER_GENERIC;
+    if (tier > g_cpuTierDetected)
+        tier = g_cpuTierDetected;
+
+    g_cpuTier = tier;
+    return tier;
+}
+
+// -1 if there is no such tier
+int findCpuTier(const char *name)
+{
+    for (int i = 0; i < NUM_CPU_TIERS; i++)
+        if (strcmp(name, cpuTierNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+void detectCpuFeatures()
+{
+    g_cpuFeatures     = readCpuFeatures();
+    g_cpuTierDetected = cpuTierForFeatures(g_cpuFeatures);
+    g_cpuTier         = g_cpuTierDetected;
+
+    printf("\nCPU features:%s%s%s%s%s%s%s%s, using %s code path\n",
+           (g_cpuFeatures & CPU_FEATURE_POPCNT)  ? " popcnt"  : "",
+           (g_cpuFeatures & CPU_FEATURE_LZCNT)   ? " lzcnt"   : "",
+           (g_cpuFeatures & CPU_FEATURE_BMI1)    ? " bmi1"    : "",
+           (g_cpuFeatures & CPU_FEATURE_BMI2)    ? " bmi2"    : "",
+           (g_cpuFeatures & CPU_FEATURE_FAST_PEXT) ? " fast_pext" : "",
+           (g_cpuFeatures & CPU_FEATURE_AVX)     ? " avx"     : "",
+           (g_cpuFeatures & CPU_FEATURE_AVX2)    ? " avx2"    : "",
+           (g_cpuFeatures & CPU_FEATURE_AVX512F) ? " avx512"  : "",
+           cpuTierNames[g_cpuTier]);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef FIXED_DEPTH_PERFT_H
+#define FIXED_DEPTH_PERFT_H
+
+// perft of the last FIXED_DEPTH_PLIES plies with the depth and the side to move as template parameters
+// (USE_FIXED_DEPTH_PERFT): no depth tests, no hash table code, and the generator templated on chance is called
+// directly (and inlined) instead of through the wrappers that test pos->chance for every node
+// perft_bb only hands over nodes that it wouldn't probe the hash tables for (variants without the hash tables), the
+// hash tables pay at depth 2 and 3 (that's what ShallowTT and the per thread cache are for)
+// A/B against the generic recursion: "perft variants" (boards vs boards-generic)
+//
+// included by MoveGeneratorBitboard.h
+
+template <int cpuTier, int sliderBackend, uint8 chance>
+MY_INLINE uint32 generateBoardsFor(HexaBitBoardPosition *pos, HexaBitBoardPosition *newPositions)
+{
+#if USE_TEMPLATE_CHANCE_OPT == 1
+    return MoveGeneratorBitboardT<cpuTier, sliderBackend>::template generateBoards<chance>(pos, newPositions);
+#else
+    return MoveGeneratorBitboardT<cpuTier, sliderBackend>::generateBoards(pos, newPositions, chance);
+#endif
+}
+
+template <int cpuTier, int sliderBackend, uint8 chance>
+MY_INLINE uint32 countMovesFor(HexaBitBoardPosition *pos)
+{
+#if USE_TEMPLATE_CHANCE_OPT == 1
+    return MoveGeneratorBitboardT<cpuTier, sliderBackend>::template countMoves<chance>(pos);
+#else
+    return MoveGeneratorBitboardT<cpuTier, sliderBackend>::countMoves(pos, chance);
+#endif
+}
+
+// (a struct as function templates can't be partially specialized on depth)
+template <int cpuTier, int sliderBackend, class Stats, uint8 chance, int depth>
+struct FixedDepthPerft
+{
+    static const uint8 next = (chance == WHITE) ? BLACK : WHITE;
+
+    static uint64 perft(HexaBitBoardPosition *pos)
+    {
+        HexaBitBoardPosition newPositions[MAX_MOVES];
+
+        PHASE_BEGIN(depth)
+        uint32 nMoves = generateBoardsFor<cpuTier, sliderBackend, chance>(pos, newPositions);
+        countNodeStats<cpuTier, sliderBackend>(pos, depth, nMoves);
+        PHASE_MARK(PHASE_GENERATE)
+
+        uint64 count = 0;
+        for (uint32 i = 0; i < nMoves; i++)
+            count += FixedDepthPerft<cpuTier, sliderBackend, Stats, next, depth - 1>::perft(&newPositions[i]);
+
+        // (the children are sampled at their own depth)
+        PHASE_SKIP()
+        return count;
+    }
+};
+
+// leaf-parent: count the moves of all the children
+template <int cpuTier, int sliderBackend, class Stats, uint8 chance>
+struct FixedDepthPerft<cpuTier, sliderBackend, Stats, chance, 2>
+{
+    static const uint8 next = (chance == WHITE) ? BLACK : WHITE;
+
+    MY_INLINE static uint64 perft(HexaBitBoardPosition *pos)
+    {
+        HexaBitBoardPosition newPositions[MAX_MOVES];
+
+        PHASE_BEGIN(2)
+        uint32 nMoves = generateBoardsFor<cpuTier, sliderBackend, chance>(pos, newPositions);
+        countNodeStats<cpuTier, sliderBackend>(pos, 2, nMoves);
+        PHASE_MARK(PHASE_GENERATE)
+
+        uint64 countStart = Stats::startTimer();
+        uint64 count = 0;
+#if USE_BATCHED_LEAF_COUNT == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+        // (the simd kernels beat the inlined countMoves, see CountMovesBatch.h)
+        if (cpuTier >= CPU_TIER_AVX2 && sliderBackend == SLIDER_KOGGE_STONE_SIMD)
+            count = countMovesBatch<cpuTier, sliderBackend>(newPositions, nMoves);
+        else
+#endif
+        for (uint32 i = 0; i < nMoves; i++)
+            count += countMovesFor<cpuTier, sliderBackend, next>(&newPositions[i]);
+        Stats::countMovesTime(countStart);
+        Stats::countMoves(nMoves);
+
+        PHASE_MARK(PHASE_COUNT)
+        return count;
+    }
+};
+
+// 2 <= depth <= FIXED_DEPTH_PLIES (2 or 3)
+template <int cpuTier, int sliderBackend, class Stats>
+MY_INLINE uint64 perftFixedDepth(HexaBitBoardPosition *pos, uint32 depth)
+{
+#if FIXED_DEPTH_PLIES >= 3
+    if (depth == 3)
+        return (pos->chance == WHITE) ? FixedDepthPerft<cpuTier, sliderBackend, Stats, WHITE, 3>::perft(pos) :
+                                        FixedDepthPerft<cpuTier, sliderBackend, Stats, BLACK, 3>::perft(pos);
+#endif
+    return (pos->chance == WHITE) ? FixedDepthPerft<cpuTier, sliderBackend, Stats, WHITE, 2>::perft(pos) :
+                                    FixedDepthPerft<cpuTier, sliderBackend, Stats, BLACK, 2>::perft(pos);
+}
+
+#endif
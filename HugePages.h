@@ -0,0 +1,129 @@
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+// page allocations for the big lookup tables, with 2 MB (large) pages when the OS gives us them
+// a single 2 MB page covers all the tables the generator touches at every node, so that a TLB miss
+// is almost never needed to get to them
+//
+// windows: large pages need the 'Lock pages in memory' privilege (SeLockMemoryPrivilege) to be granted to the user
+// linux:   explicitly reserved huge pages (MAP_HUGETLB) if there are any, otherwise transparent huge pages
+
+#include "chess.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define HUGE_PAGE_SHIFT 21
+#define HUGE_PAGE_SIZE  (1 << HUGE_PAGE_SHIFT)    // 2 MB
+
+// kind of pages an allocation ended up with
+#define PAGES_SMALL             0
+#define PAGES_HUGE              1   // large pages allocated explicitly (and locked in memory)
+#define PAGES_TRANSPARENT_HUGE  2   // 2 MB aligned and the kernel asked to use huge pages (it may not always be able to)
+
+static const char *pageTypeNames[] = { "4 KB pages", "2 MB pages", "transparent huge pages" };
+
+#ifdef _WIN32
+static bool enableLockMemoryPrivilege()
+{
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+
+    TOKEN_PRIVILEGES tp;
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+              GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+#endif
+
+// allocates (zeroed) memory of at least the given size
+// hugePages == false forces small pages (only useful for measuring the difference)
+// returns NULL on failure, pageType (optional) gets one of the PAGES_* values
+void *allocPages(size_t size, bool hugePages, int *pageType = NULL)
+{
+    void *mem = NULL;
+    int   type = PAGES_SMALL;
+    size_t hugeSize = (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+
+#ifdef _WIN32
+    if (hugePages)
+    {
+        static bool privilegeEnabled = enableLockMemoryPrivilege();
+        size_t largePageSize = GetLargePageMinimum();
+        if (privilegeEnabled && largePageSize)
+        {
+            size_t largeSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+            mem = VirtualAlloc(NULL, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (mem)
+                type = PAGES_HUGE;
+        }
+    }
+    if (!mem)
+    {
+        mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+#else
+    if (hugePages)
+    {
+        mem = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            // no reserved huge pages: get a 2 MB aligned range and ask for transparent huge pages
+            // (the unaligned head and tail are given back)
+            mem = NULL;
+            uint8 *raw = (uint8 *) mmap(NULL, hugeSize + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw != MAP_FAILED)
+            {
+                uint8 *aligned = (uint8 *) (((size_t) raw + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1));
+                if (aligned != raw)
+                    munmap(raw, aligned - raw);
+                munmap(aligned + hugeSize, (raw + hugeSize + HUGE_PAGE_SIZE) - (aligned + hugeSize));
+                mem = aligned;
+#ifdef MADV_HUGEPAGE
+                if (madvise(mem, hugeSize, MADV_HUGEPAGE) == 0)
+                    type = PAGES_TRANSPARENT_HUGE;
+#endif
+            }
+        }
+        else
+        {
+            type = PAGES_HUGE;
+        }
+    }
+    if (!mem)
+    {
+        mem = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            mem = NULL;
+#ifdef MADV_NOHUGEPAGE
+        else if (!hugePages)
+            madvise(mem, hugeSize, MADV_NOHUGEPAGE);
+#endif
+    }
+#endif
+
+    if (pageType)
+        *pageType = type;
+    return mem;
+}
+
+void freePages(void *mem, size_t size)
+{
+    if (!mem)
+        return;
+#ifdef _WIN32
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1));
+#endif
+}
+
+#endif
@@ -0,0 +1,465 @@
+#ifndef INTERLEAVED_PERFT_H
+#define INTERLEAVED_PERFT_H
+
+// perft with the transposition table probes of several subtrees overlapped
+// the plain recursive perft_bb waits for every probe of the (multi GB) tables, and almost all of them miss the
+// caches. Here each thread runs INTERLEAVED_WALKERS walkers, each searching its own subtree depth first with an
+// explicit stack. When a walker gets to a node that needs a probe it prefetches the slot and the thread switches to
+// the next walker, so by the time it gets back to this one the slot is (hopefully) in L1, and the DRAM latency was
+// spent generating moves for the other walkers
+//
+// the subtrees are the positions INTERLEAVED_SPLIT_PLIES below the root, handed out to walkers as they finish
+// the root and the subtrees are looked up in (and added to) the result store, the nodes inside the walkers aren't
+// the walkers follow the adaptive per depth policy (USE_ADAPTIVE_TT): a node at a depth that is off is searched
+// right away. As the walkers of a thread take turns, a subtree is timed with the cycles of its own walker's steps
+//
+// included by MoveGeneratorBitboard.h (after perft_bb)
+
+#include <xmmintrin.h>
+
+// walkers per thread: enough to cover the memory latency with move generation
+#define INTERLEAVED_WALKERS         8
+#define INTERLEAVED_SPLIT_PLIES     2
+#define INTERLEAVED_MAX_DEPTH       20
+
+struct WalkerFrame
+{
+    TT_Entry             entry;     // slot as it was read when probing this node (for storeTTEntry)
+    uint64               hash;
+    uint64               count;
+    uint32               depth;
+    uint32               nChildren;
+    uint32               next;      // next child to visit
+    bool                 useTT;     // probed, and to be stored
+    bool                 timed;     // sampled for the depth policy (subtreeStart is valid)
+    uint64               subtreeStart;
+    HexaBitBoardPosition children[MAX_MOVES];
+};
+
+struct PerftWalker
+{
+    int                  top;       // top of frames[], -1 when the walker has nothing to do
+    bool                 probePending;
+    HexaBitBoardPosition pendingPos;        // node whose slot has been prefetched
+    uint32               pendingDepth;
+    uint64               pendingHash;
+    bool                 pendingTimed;      // sampled for the depth policy
+    uint64               pendingKeyCycles;  // spent on the hash key (when timed)
+    uint64              *result;            // where the count of the subtree goes
+#if USE_ADAPTIVE_TT == 1
+    // the walker's own cycles, only counted (in its steps) while some of its nodes are timed
+    int                  timedNodes;
+    uint64               cycles;
+    uint64               stepStart;
+#endif
+    WalkerFrame          frames[INTERLEAVED_MAX_DEPTH];
+};
+
+#if USE_ADAPTIVE_TT == 1
+MY_INLINE void walkerStepBegin(PerftWalker *walker)
+{
+    if (walker->timedNodes)
+        walker->stepStart = __rdtsc();
+}
+
+MY_INLINE void walkerStepEnd(PerftWalker *walker)
+{
+    if (walker->timedNodes)
+        walker->cycles += __rdtsc() - walker->stepStart;
+}
+
+// (during a step only)
+MY_INLINE uint64 walkerTimingBegin(PerftWalker *walker)
+{
+    if (walker->timedNodes++ == 0)
+        walker->stepStart = __rdtsc();
+    return walker->cycles + (__rdtsc() - walker->stepStart);
+}
+
+MY_INLINE uint64 walkerTimingEnd(PerftWalker *walker)
+{
+    uint64 now = walker->cycles + (__rdtsc() - walker->stepStart);
+    if (--walker->timedNodes == 0)
+        walker->cycles = now;
+    return now;
+}
+#else
+MY_INLINE void walkerStepBegin(PerftWalker *walker) {}
+MY_INLINE void walkerStepEnd(PerftWalker *walker) {}
+#endif
+
+MY_INLINE void prefetchTTSlot(uint64 hash, uint32 depth)
+{
+#if USE_SHALLOW_TT == 1
+    if (depth == 2)
+    {
+        _mm_prefetch((const char *) &ShallowTT[hash & (SHALLOW_TT_INDEX_BITS)], _MM_HINT_T0);
+        return;
+    }
+#endif
+    _mm_prefetch((const char *) &TranspositionTable[hash & (TT_INDEX_BITS)], _MM_HINT_T0);
+}
+
+template <class Stats>
+MY_INLINE bool probeWalkerNode(uint64 hash, uint32 depth, uint64 *perft, TT_Entry *entry)
+{
+    Stats::probe(depth);
+#if USE_SHALLOW_TT == 1
+    if (depth == 2)
+    {
+        uint64 slot = lookupSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS));
+        if ((slot & SHALLOW_TT_HASH_BITS) != (hash & SHALLOW_TT_HASH_BITS))
+            return false;
+        *perft = slot & SHALLOW_TT_INDEX_BITS;
+    }
+    else
+#endif
+    {
+        *entry = lookupTT(hash);
+        if (!searchTTEntry<Stats>(*entry, hash, perft))
+            return false;
+    }
+    Stats::hit(depth);
+#if USE_TT_CACHE == 1
+    storeTTCache(hash, depth, *perft);
+#endif
+    return true;
+}
+
+template <class Stats>
+MY_INLINE void storeWalkerNode(uint64 hash, uint32 depth, uint64 count, TT_Entry *entry, HexaBitBoardPosition *pos)
+{
+    Stats::store(depth);
+#if USE_TT_CACHE == 1
+    storeTTCache(hash, depth, count);
+#endif
+#if USE_SHALLOW_TT == 1
+    if (depth == 2)
+    {
+        storeSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS), (hash  & SHALLOW_TT_HASH_BITS)  |
+                                                                                (count & SHALLOW_TT_INDEX_BITS));
+    }
+    else
+#endif
+    {
+        storeTTEntry(*entry, hash, depth, count, pos);
+    }
+}
+
+// a node (or a whole subtree) of the walker is done
+MY_INLINE void finishWalkerNode(PerftWalker *walker, uint64 count)
+{
+    if (walker->top < 0)
+        *walker->result = count;
+    else
+        walker->frames[walker->top].count += count;
+}
+
+// a probe missed (or the depth doesn't use the hash tables, entry NULL): search the node
+template <int cpuTier, int sliderBackend, class Stats>
+void enterWalkerNode(PerftWalker *walker, HexaBitBoardPosition *pos, uint32 depth, uint64 hash, TT_Entry *entry, bool timed)
+{
+    WalkerFrame *frame = &walker->frames[walker->top + 1];
+#if USE_ADAPTIVE_TT == 1
+    // (a leaf-parent is done within this call)
+    uint64 leafParentStart = (timed && depth == 2) ? __rdtsc() : 0;
+#endif
+    PHASE_BEGIN(depth)
+    frame->nChildren = generateBoards<cpuTier, sliderBackend>(pos, frame->children);
+    countNodeStats<cpuTier, sliderBackend>(pos, depth, frame->nChildren);
+    PHASE_MARK(PHASE_GENERATE)
+
+    // leaf-parent: no probes below, finish it right away
+    if (depth == 2)
+    {
+        uint64 countStart = Stats::startTimer();
+        uint64 count = countMovesBatch<cpuTier, sliderBackend>(frame->children, frame->nChildren);
+        Stats::countMovesTime(countStart);
+        Stats::countMoves(frame->nChildren);
+        PHASE_MARK(PHASE_COUNT)
+#if USE_ADAPTIVE_TT == 1
+        ttSampleSubtree(&ttDepthPolicy[depth], leafParentStart);
+#endif
+        if (entry)
+        {
+            storeWalkerNode<Stats>(hash, depth, count, entry, pos);
+            PHASE_MARK(PHASE_STORE)
+        }
+        finishWalkerNode(walker, count);
+        return;
+    }
+
+    if (entry)
+        frame->entry = *entry;
+    frame->useTT = entry != NULL;
+    frame->hash  = hash;
+    frame->count = 0;
+    frame->depth = depth;
+    frame->next  = 0;
+    frame->timed = false;
+#if USE_ADAPTIVE_TT == 1
+    if (timed)
+    {
+        frame->timed        = true;
+        frame->subtreeStart = walkerTimingBegin(walker);
+    }
+#endif
+    walker->top++;
+}
+
+// start (probe) a node: prefetch its slot and leave the rest for the next step of the walker
+// returns false if there is nothing to wait for: the node was found in the per thread cache, or its depth doesn't
+// use the hash tables (then it's searched right away)
+template <int cpuTier, int sliderBackend, class Stats>
+MY_INLINE bool startWalkerNode(PerftWalker *walker, HexaBitBoardPosition *pos, uint32 depth)
+{
+    bool timed = false;
+#if USE_ADAPTIVE_TT == 1
+    TTDepthPolicy *policy = &ttDepthPolicy[depth];
+    uint64 sampleStart = ttSampleStart(policy);
+    timed = sampleStart != 0;
+    if (policy->disabled)
+    {
+        enterWalkerNode<cpuTier, sliderBackend, Stats>(walker, pos, depth, 0, NULL, timed);
+        return false;
+    }
+#endif
+
+    uint64 zobristStart = Stats::startTimer();
+    uint64 hash = computeZobristKey(pos) ^ (zob.depth * depth);
+    Stats::zobristTime(zobristStart);
+
+#if USE_TT_CACHE == 1
+    uint64 cachedPerft;
+    if (probeTTCache<Stats>(hash, depth, &cachedPerft))
+    {
+        countProbeStats(depth, true);
+#if USE_ADAPTIVE_TT == 1
+        ttSampleProbe(policy, sampleStart, true);
+#endif
+        finishWalkerNode(walker, cachedPerft);
+        return false;
+    }
+#endif
+
+    prefetchTTSlot(hash, depth);
+    walker->probePending = true;
+    walker->pendingPos   = *pos;
+    walker->pendingDepth = depth;
+    walker->pendingHash  = hash;
+    walker->pendingTimed = timed;
+#if USE_ADAPTIVE_TT == 1
+    walker->pendingKeyCycles = timed ? __rdtsc() - sampleStart : 0;
+#endif
+    return true;
+}
+
+// run the walker till its next probe, returns false when its subtree is done
+template <int cpuTier, int sliderBackend, class Stats>
+bool stepWalker(PerftWalker *walker)
+{
+    if (walker->probePending)
+    {
+        // the slot was prefetched when we were last here
+        walker->probePending = false;
+
+        TT_Entry entry;
+        uint64 perftVal;
+        // (the phases of a walker node are spread over its steps, each one is sampled on its own)
+        PHASE_BEGIN(walker->pendingDepth)
+#if USE_ADAPTIVE_TT == 1
+        // (the probe's cost is the hash key and this part: the walkers in between ran on the prefetch's time)
+        uint64 probeStart = walker->pendingTimed ? __rdtsc() - walker->pendingKeyCycles : 0;
+#endif
+        bool found = probeWalkerNode<Stats>(walker->pendingHash, walker->pendingDepth, &perftVal, &entry);
+        PHASE_MARK(PHASE_PROBE)
+        countProbeStats(walker->pendingDepth, found);
+#if USE_ADAPTIVE_TT == 1
+        ttSampleProbe(&ttDepthPolicy[walker->pendingDepth], probeStart, found);
+#endif
+        if (found)
+            finishWalkerNode(walker, perftVal);
+        else
+            enterWalkerNode<cpuTier, sliderBackend, Stats>(walker, &walker->pendingPos, walker->pendingDepth, walker->pendingHash,
+                                                           &entry, walker->pendingTimed);
+    }
+
+    while (walker->top >= 0)
+    {
+        WalkerFrame *frame = &walker->frames[walker->top];
+        if (frame->next == frame->nChildren)
+        {
+            // all children done: store and return the count to the parent
+#if USE_ADAPTIVE_TT == 1
+            if (frame->timed)
+                ttSampleSubtree(&ttDepthPolicy[frame->depth], __rdtsc() - (walkerTimingEnd(walker) - frame->subtreeStart));
+#endif
+            if (frame->useTT)
+            {
+                PHASE_BEGIN(frame->depth)
+                storeWalkerNode<Stats>(frame->hash, frame->depth, frame->count, &frame->entry, NULL);
+                PHASE_MARK(PHASE_STORE)
+            }
+            walker->top--;
+            finishWalkerNode(walker, frame->count);
+            continue;
+        }
+
+        HexaBitBoardPosition *child = &frame->children[frame->next++];
+        if (startWalkerNode<cpuTier, sliderBackend, Stats>(walker, child, frame->depth - 1))
+            return true;
+    }
+
+    return walker->probePending;
+}
+
+// positions INTERLEAVED_SPLIT_PLIES (or less if the game ends earlier) below the root, and their depth
+struct WalkerTask
+{
+    HexaBitBoardPosition pos;
+    uint32               depth;
+    uint64               count;
+    bool                 fromStore;     // count found in the result store
+};
+
+template <int cpuTier, int sliderBackend, class Stats>
+void splitPerft(HexaBitBoardPosition *pos, uint32 depth, int plies, WalkerTask **tasks, uint32 *nTasks, uint32 *maxTasks)
+{
+    if (plies == 0 || depth <= 2)
+    {
+        if (*nTasks == *maxTasks)
+        {
+            *maxTasks *= 2;
+            *tasks = (WalkerTask *) realloc(*tasks, *maxTasks * sizeof(WalkerTask));
+        }
+        (*tasks)[*nTasks].pos   = *pos;
+        (*tasks)[*nTasks].depth = depth;
+        (*tasks)[*nTasks].count = 0;
+        (*tasks)[*nTasks].fromStore = false;
+        (*nTasks)++;
+        return;
+    }
+
+    HexaBitBoardPosition children[MAX_MOVES];
+    uint32 nChildren = generateBoards<cpuTier, sliderBackend>(pos, children);
+    countNodeStats<cpuTier, sliderBackend>(pos, depth, nChildren);
+    for (uint32 i = 0; i < nChildren; i++)
+        splitPerft<cpuTier, sliderBackend, Stats>(&children[i], depth - 1, plies - 1, tasks, nTasks, maxTasks);
+}
+
+template <int cpuTier, int sliderBackend, class Stats = NoPerftStats>
+uint64 perft_interleaved(HexaBitBoardPosition *pos, uint32 depth)
+{
+    if (depth <= INTERLEAVED_SPLIT_PLIES + 2 || depth > INTERLEAVED_MAX_DEPTH)
+        return perft_bb<cpuTier, sliderBackend, Stats>(pos, 0, depth);
+
+#if USE_RESULT_STORE == 1
+    HashKey128b resultKey;
+    bool useResultStore = resultStoreOpen();
+    if (useResultStore && depth >= RESULT_STORE_MIN_DEPTH)
+    {
+        resultKey = computeZobristKey128(pos);
+        uint64 storedCount;
+        if (lookupResult(resultKey, depth, &storedCount))
+            return storedCount;
+    }
+#endif
+
+    uint32 nTasks = 0, maxTasks = 1024;
+    WalkerTask *tasks = (WalkerTask *) malloc(maxTasks * sizeof(WalkerTask));
+    splitPerft<cpuTier, sliderBackend, Stats>(pos, depth, INTERLEAVED_SPLIT_PLIES, &tasks, &nTasks, &maxTasks);
+
+    PerftWalker *walkers = (PerftWalker *) malloc(INTERLEAVED_WALKERS * sizeof(PerftWalker));
+    bool busy[INTERLEAVED_WALKERS];
+    uint32 nextTask = 0;
+    int numBusy = 0;
+
+    for (int i = 0; i < INTERLEAVED_WALKERS; i++)
+    {
+        walkers[i].top = -1;
+        walkers[i].probePending = false;
+#if USE_ADAPTIVE_TT == 1
+        walkers[i].timedNodes = 0;
+        walkers[i].cycles = 0;
+#endif
+        busy[i] = false;
+    }
+
+    // round robin over the walkers, giving a new subtree to each one that's done
+    do
+    {
+        for (int i = 0; i < INTERLEAVED_WALKERS; i++)
+        {
+            PerftWalker *walker = &walkers[i];
+            walkerStepBegin(walker);
+            if (busy[i])
+            {
+                busy[i] = stepWalker<cpuTier, sliderBackend, Stats>(walker);
+                numBusy -= !busy[i];
+            }
+
+            while (!busy[i] && nextTask < nTasks)
+            {
+                // (game over positions above the split depth go straight to perft_bb)
+                WalkerTask *task = &tasks[nextTask++];
+                if (task->depth <= 2)
+                {
+                    task->count = perft_bb<cpuTier, sliderBackend, Stats>(&task->pos, 0, task->depth);
+                    continue;
+                }
+#if USE_RESULT_STORE == 1
+                // (looked up as late as possible: other threads may have added it meanwhile)
+                if (useResultStore && task->depth >= RESULT_STORE_MIN_DEPTH &&
+                    lookupResult(computeZobristKey128(&task->pos), task->depth, &task->count))
+                {
+                    task->fromStore = true;
+                    continue;
+                }
+#endif
+                walker->result = &task->count;
+                startWalkerNode<cpuTier, sliderBackend, Stats>(walker, &task->pos, task->depth);
+                busy[i] = walker->probePending || walker->top >= 0;
+                numBusy += busy[i];
+            }
+            walkerStepEnd(walker);
+        }
+    } while (numBusy);
+
+    uint64 count = 0;
+    for (uint32 i = 0; i < nTasks; i++)
+    {
+        count += tasks[i].count;
+#if USE_RESULT_STORE == 1
+        if (useResultStore && tasks[i].depth >= RESULT_STORE_MIN_DEPTH && !tasks[i].fromStore)
+            storeResult(computeZobristKey128(&tasks[i].pos), tasks[i].depth, tasks[i].count);
+#endif
+    }
+#if USE_RESULT_STORE == 1
+    if (useResultStore && depth >= RESULT_STORE_MIN_DEPTH)
+        storeResult(resultKey, depth, count);
+#endif
+
+    free(walkers);
+    free(tasks);
+    return count;
+}
+
+template <int cpuTier, int sliderBackend>
+uint64 perft_interleaved_counting(HexaBitBoardPosition *pos, uint32 depth)
+{
+    return perft_interleaved<cpuTier, sliderBackend, CountingPerftStats>(pos, depth);
+}
+
+uint64 perft_interleaved(HexaBitBoardPosition *pos, uint32 depth)
+{
+    // the other engine variants only have the recursive driver
+    if (g_perftVariant != PERFT_VARIANT_DEFAULT)
+        return perft_bb(pos, 0, depth);
+    if (g_perftStats)
+    {
+        CALL_FOR_GENERATOR(perft_interleaved_counting, pos, depth);
+    }
+    CALL_FOR_GENERATOR(perft_interleaved, pos, depth);
+}
+
+#endif
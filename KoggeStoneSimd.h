@@ -0,0 +1,179 @@
+#ifndef KOGGE_STONE_SIMD_H
+#define KOGGE_STONE_SIMD_H
+
+// kogge-stone sliding piece fills for all 8 ray directions at once, one direction per simd lane
+// used by the avx2/avx-512 instances of the kogge-stone simd backend (SLIDER_KOGGE_STONE_SIMD) to find the squares
+// attacked by all enemy sliders and the pieces pinned to the king in a single pass (see
+// MoveGeneratorBitboardT::findPinnedAndAttacked). The other backends find them with their own attack functions
+//
+// every direction is a rotate left by a fixed amount (e.g, south = rotate by 56) followed by masking off the
+// squares that wrapped around the board (generalized rays in chess programming wiki)
+//
+// lane order: north, east, south, west (rook directions), north east, north west, south east, south west
+// avx2 works on the rook and bishop directions as two separate 4 lane vectors, avx-512 on all 8 lanes at once
+
+#include "chess.h"
+#include <intrin.h>
+
+// cpu only, and needs the 64 bit intrinsics
+#if !defined(__CUDA_ARCH__) && defined(_WIN64)
+
+#define KS_NOT_FILEA  C64(0xFEFEFEFEFEFEFEFE)
+#define KS_NOT_FILEH  C64(0x7F7F7F7F7F7F7F7F)
+#define KS_NOT_RANK1  C64(0xFFFFFFFFFFFFFF00)
+#define KS_NOT_RANK8  C64(0x00FFFFFFFFFFFFFF)
+
+// rotate amounts of the 3 kogge-stone steps (1, 2 and 4 squares) for each direction
+static const uint64 ksRotate[3][8] =
+{
+    {  8,  1, 56, 63,     9,  7, 57, 55 },
+    { 16,  2, 48, 62,    18, 14, 50, 46 },
+    { 32,  4, 32, 60,    36, 28, 36, 28 },
+};
+
+// squares that can be reached in each direction without wrapping around the board
+static const uint64 ksAvoidWrap[8] =
+{
+    KS_NOT_RANK1, KS_NOT_FILEA, KS_NOT_RANK8, KS_NOT_FILEH,
+    KS_NOT_RANK1 & KS_NOT_FILEA, KS_NOT_RANK1 & KS_NOT_FILEH, KS_NOT_RANK8 & KS_NOT_FILEA, KS_NOT_RANK8 & KS_NOT_FILEH
+};
+
+
+// ----------------------------------------------- avx2 -----------------------------------------------
+
+// avx2 doesn't have 64 bit rotates
+#define KS_ROTL_AVX2(x, r, rc)    _mm256_or_si256(_mm256_sllv_epi64((x), (r)), _mm256_srlv_epi64((x), (rc)))
+
+struct KoggeStoneDirsAvx2
+{
+    __m256i r1, r2, r4;         // rotate amounts
+    __m256i rc1, rc2, rc4;      // 64 - rotate amounts
+    __m256i avoidWrap;
+};
+
+// rook == true: the 4 rook directions, otherwise the 4 bishop directions
+MY_INLINE static KoggeStoneDirsAvx2 koggeStoneDirsAvx2(bool rook)
+{
+    int first = rook ? 0 : 4;
+
+    KoggeStoneDirsAvx2 d;
+    d.r1 = _mm256_loadu_si256((const __m256i *) &ksRotate[0][first]);
+    d.r2 = _mm256_loadu_si256((const __m256i *) &ksRotate[1][first]);
+    d.r4 = _mm256_loadu_si256((const __m256i *) &ksRotate[2][first]);
+    d.avoidWrap = _mm256_loadu_si256((const __m256i *) &ksAvoidWrap[first]);
+
+    __m256i all64 = _mm256_set1_epi64x(64);
+    d.rc1 = _mm256_sub_epi64(all64, d.r1);
+    d.rc2 = _mm256_sub_epi64(all64, d.r2);
+    d.rc4 = _mm256_sub_epi64(all64, d.r4);
+    return d;
+}
+
+// attacks in the 4 directions of the sliders in gen (not including the squares of the sliders themselves)
+// pro - empty squares
+MY_INLINE static __m256i koggeStoneAttacksAvx2(__m256i gen, __m256i pro, const KoggeStoneDirsAvx2 &d)
+{
+    pro = _mm256_and_si256(pro, d.avoidWrap);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, KS_ROTL_AVX2(gen, d.r1, d.rc1)));
+    pro = _mm256_and_si256(pro, KS_ROTL_AVX2(pro, d.r1, d.rc1));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, KS_ROTL_AVX2(gen, d.r2, d.rc2)));
+    pro = _mm256_and_si256(pro, KS_ROTL_AVX2(pro, d.r2, d.rc2));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, KS_ROTL_AVX2(gen, d.r4, d.rc4)));
+    return _mm256_and_si256(KS_ROTL_AVX2(gen, d.r1, d.rc1), d.avoidWrap);
+}
+
+MY_INLINE static uint64 horizontalOrAvx2(__m256i x)
+{
+    __m128i x2 = _mm_or_si128(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    return _mm_cvtsi128_si64(x2) | _mm_extract_epi64(x2, 1);
+}
+
+// squares attacked by the enemy sliders, and pieces pinned to the king
+// (any piece that is alone between the king and an enemy slider, same as findPinnedPieces)
+MY_INLINE static void koggeStoneAttacksAndPinsAvx2(uint64 enemyBishops, uint64 enemyRooks, uint64 myKing, uint64 allPieces,
+                                                   uint64 *attacked, uint64 *pinned)
+{
+    KoggeStoneDirsAvx2 rookDirs   = koggeStoneDirsAvx2(true);
+    KoggeStoneDirsAvx2 bishopDirs = koggeStoneDirsAvx2(false);
+
+    __m256i empty  = _mm256_set1_epi64x(~allPieces);
+    __m256i king   = _mm256_set1_epi64x(myKing);
+    __m256i all    = _mm256_set1_epi64x(allPieces);
+    __m256i zero   = _mm256_setzero_si256();
+    __m256i rooks   = _mm256_set1_epi64x(enemyRooks);
+    __m256i bishops = _mm256_set1_epi64x(enemyBishops);
+
+    // 1. attacks of all sliders (squares behind the king are also attacked)
+    __m256i sliderPro = _mm256_or_si256(empty, king);
+    __m256i rookAttacks   = koggeStoneAttacksAvx2(rooks,   sliderPro, rookDirs);
+    __m256i bishopAttacks = koggeStoneAttacksAvx2(bishops, sliderPro, bishopDirs);
+
+    // 2. rays from the king to the first piece in every direction, and from there to the next one
+    __m256i rookBlockers   = _mm256_and_si256(koggeStoneAttacksAvx2(king, empty, rookDirs),   all);
+    __m256i bishopBlockers = _mm256_and_si256(koggeStoneAttacksAvx2(king, empty, bishopDirs), all);
+
+    __m256i rookPinners    = _mm256_and_si256(koggeStoneAttacksAvx2(king, _mm256_or_si256(empty, rookBlockers),   rookDirs),   rooks);
+    __m256i bishopPinners  = _mm256_and_si256(koggeStoneAttacksAvx2(king, _mm256_or_si256(empty, bishopBlockers), bishopDirs), bishops);
+
+    // 3. blocker is pinned when there is a slider (of the right type) behind it
+    __m256i rookPinned   = _mm256_andnot_si256(_mm256_cmpeq_epi64(rookPinners,   zero), rookBlockers);
+    __m256i bishopPinned = _mm256_andnot_si256(_mm256_cmpeq_epi64(bishopPinners, zero), bishopBlockers);
+
+    *attacked = horizontalOrAvx2(_mm256_or_si256(rookAttacks, bishopAttacks));
+    *pinned   = horizontalOrAvx2(_mm256_or_si256(rookPinned,  bishopPinned));
+}
+
+
+// --------------------------------------------- avx-512 ---------------------------------------------
+
+struct KoggeStoneDirsAvx512
+{
+    __m512i r1, r2, r4;
+    __m512i avoidWrap;
+};
+
+MY_INLINE static KoggeStoneDirsAvx512 koggeStoneDirsAvx512()
+{
+    KoggeStoneDirsAvx512 d;
+    d.r1 = _mm512_loadu_si512(&ksRotate[0][0]);
+    d.r2 = _mm512_loadu_si512(&ksRotate[1][0]);
+    d.r4 = _mm512_loadu_si512(&ksRotate[2][0]);
+    d.avoidWrap = _mm512_loadu_si512(&ksAvoidWrap[0]);
+    return d;
+}
+
+MY_INLINE static __m512i koggeStoneAttacksAvx512(__m512i gen, __m512i pro, const KoggeStoneDirsAvx512 &d)
+{
+    pro = _mm512_and_si512(pro, d.avoidWrap);
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, d.r1)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, d.r1));
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, d.r2)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, d.r2));
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, d.r4)));
+    return _mm512_and_si512(_mm512_rolv_epi64(gen, d.r1), d.avoidWrap);
+}
+
+MY_INLINE static void koggeStoneAttacksAndPinsAvx512(uint64 enemyBishops, uint64 enemyRooks, uint64 myKing, uint64 allPieces,
+                                                     uint64 *attacked, uint64 *pinned)
+{
+    KoggeStoneDirsAvx512 dirs = koggeStoneDirsAvx512();
+
+    __m512i empty   = _mm512_set1_epi64(~allPieces);
+    __m512i king    = _mm512_set1_epi64(myKing);
+    __m512i all     = _mm512_set1_epi64(allPieces);
+
+    // rooks in the first 4 lanes, bishops in the rest
+    __m512i sliders = _mm512_mask_blend_epi64(0xF0, _mm512_set1_epi64(enemyRooks), _mm512_set1_epi64(enemyBishops));
+
+    __m512i sliderAttacks = koggeStoneAttacksAvx512(sliders, _mm512_or_si512(empty, king), dirs);
+
+    __m512i blockers = _mm512_and_si512(koggeStoneAttacksAvx512(king, empty, dirs), all);
+    __m512i pinners  = _mm512_and_si512(koggeStoneAttacksAvx512(king, _mm512_or_si512(empty, blockers), dirs), sliders);
+
+    *attacked = _mm512_reduce_or_epi64(sliderAttacks);
+    *pinned   = _mm512_reduce_or_epi64(_mm512_maskz_mov_epi64(_mm512_test_epi64_mask(pinners, pinners), blockers));
+}
+
+#endif // #if !defined(__CUDA_ARCH__) && defined(_WIN64)
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+// "perft micro": time the generator primitives in isolation
+// inputs come from real positions: all positions 2 plies below the bench positions (see BenchSuite.h), and the
+// occupancies, pieces and moves found in them. Each primitive is timed two ways:
+// - throughput: independent calls over all the inputs (what the generator mostly sees, many in flight at once)
+// - chained:    the input of every call depends on the result of the previous one, i.e. the latency
+// ns/op is wall clock, cycles/op is rdtsc (reference cycles: differs from core cycles with turbo/power saving)
+// the slider dependent primitives are timed for every backend (findPinnedPieces isn't one: it only uses the empty
+// board attack tables). The kogge-stone simd backend's single piece attacks are the fancy magics', only its
+// findPinnedAndAttacked is timed
+//
+// included by perft.cpp (after BenchSuite.h)
+
+#define MICRO_CORPUS_SIZE   4096        // positions (48 bytes each, stays in L2)
+#define MICRO_OPS           (1 << 24)   // calls per timing
+
+// always 0, but the compiler can't know that: (result & microChainMask) makes the next input depend on the result
+static volatile uint64 microChainMask = 0;
+
+// results are summed here so that the calls can't be optimized away
+static volatile uint64 microSink;
+
+struct MicroPinInput
+{
+    uint64 myKing, myPieces, enemyBishops, enemyRooks, allPieces, enemyPawns, enemyKnights, enemyKing;
+    uint8  kingIndex, enemyColor;
+};
+
+struct MicroMoveInput
+{
+    HexaBitBoardPosition pos;
+    CMove                move;
+};
+
+struct MicroSliderInput
+{
+    uint64 piece;
+    uint64 pro;
+};
+
+struct MicroCorpus
+{
+    int               numPositions;
+    int               numBitboards; // (for popCount/bitScan)
+    int               numBishops;
+    int               numRooks;
+    int               numMoves;
+    HexaBitBoardPosition positions[MICRO_CORPUS_SIZE];
+    uint64            bitboards[MICRO_CORPUS_SIZE];
+    MicroPinInput     pinInputs[MICRO_CORPUS_SIZE];
+    MicroSliderInput  bishops[MICRO_CORPUS_SIZE];
+    MicroSliderInput  rooks[MICRO_CORPUS_SIZE];
+    MicroMoveInput    moves[MICRO_CORPUS_SIZE];
+};
+
+static void addMicroPosition(MicroCorpus *corpus, HexaBitBoardPosition *pos)
+{
+    if (corpus->numPositions == MICRO_CORPUS_SIZE)
+        return;
+    corpus->positions[corpus->numPositions++] = *pos;
+
+    uint8  chance       = pos->chance;
+    uint64 allPawns     = pos->pawns & RANKS2TO7;
+    uint64 allPieces    = pos->kings | allPawns | pos->knights | pos->bishopQueens | pos->rookQueens;
+    uint64 blackPieces  = allPieces & (~pos->whitePieces);
+    uint64 myPieces     = (chance == WHITE) ? pos->whitePieces : blackPieces;
+    uint64 enemyPieces  = (chance == WHITE) ? blackPieces      : pos->whitePieces;
+
+    MicroPinInput *pin = &corpus->pinInputs[corpus->numPositions - 1];
+    pin->myKing       = pos->kings & myPieces;
+    pin->myPieces     = myPieces;
+    pin->enemyBishops = pos->bishopQueens & enemyPieces;
+    pin->enemyRooks   = pos->rookQueens & enemyPieces;
+    pin->allPieces    = allPieces;
+    pin->enemyPawns   = allPawns & enemyPieces;
+    pin->enemyKnights = pos->knights & enemyPieces;
+    pin->enemyKing    = pos->kings & enemyPieces;
+    pin->kingIndex    = bitScan(pin->myKing);
+    pin->enemyColor   = !chance;
+
+    // the (non empty) piece sets of the position
+    uint64 sets[] = { allPieces, myPieces, enemyPieces, allPawns, pos->knights, pos->bishopQueens, pos->rookQueens };
+    for (int i = 0; i < (int) (sizeof(sets) / sizeof(sets[0])) && corpus->numBitboards < MICRO_CORPUS_SIZE; i++)
+        if (sets[i])
+            corpus->bitboards[corpus->numBitboards++] = sets[i];
+
+    for (uint64 pieces = pos->bishopQueens & myPieces; pieces && corpus->numBishops < MICRO_CORPUS_SIZE; pieces &= pieces - 1)
+    {
+        corpus->bishops[corpus->numBishops].piece = pieces & (0 - pieces);
+        corpus->bishops[corpus->numBishops].pro   = ~allPieces;
+        corpus->numBishops++;
+    }
+    for (uint64 pieces = pos->rookQueens & myPieces; pieces && corpus->numRooks < MICRO_CORPUS_SIZE; pieces &= pieces - 1)
+    {
+        corpus->rooks[corpus->numRooks].piece = pieces & (0 - pieces);
+        corpus->rooks[corpus->numRooks].pro   = ~allPieces;
+        corpus->numRooks++;
+    }
+
+    // one move per position (a different one each time)
+    CMove genMoves[MAX_MOVES];
+    uint32 nMoves = generateMoves(pos, genMoves);
+    if (nMoves && corpus->numMoves < MICRO_CORPUS_SIZE)
+    {
+        corpus->moves[corpus->numMoves].pos  = *pos;
+        corpus->moves[corpus->numMoves].move = genMoves[corpus->numPositions % nMoves];
+        corpus->numMoves++;
+    }
+}
+
+static void buildMicroCorpus(MicroCorpus *corpus)
+{
+    corpus->numPositions = corpus->numBitboards = corpus->numBishops = corpus->numRooks = corpus->numMoves = 0;
+
+    // round robin over the bench positions so that all of them make it in
+    static HexaBitBoardPosition ply1[NUM_BENCH_CASES][MAX_MOVES];
+    static HexaBitBoardPosition ply2[MAX_MOVES];
+    uint32 numPly1[NUM_BENCH_CASES];
+    for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+    {
+        BoardPosition testBoard;
+        HexaBitBoardPosition testBB;
+        Utils::readFENString((char *) benchCases[i].fen, &testBoard);
+        Utils::board088ToHexBB(&testBB, &testBoard);
+        numPly1[i] = generateBoards(&testBB, ply1[i]);
+    }
+
+    for (uint32 j = 0; j < MAX_MOVES; j++)
+    {
+        for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        {
+            if (j >= numPly1[i])
+                continue;
+            uint32 n = generateBoards(&ply1[i][j], ply2);
+            for (uint32 k = 0; k < n; k++)
+                addMicroPosition(corpus, &ply2[k]);
+        }
+    }
+}
+
+struct MicroTime
+{
+    double nsPerOp;
+    double cyclesPerOp;
+};
+
+// calls Op::run on the inputs over and over (MICRO_OPS calls in all)
+template <class Op, bool chained>
+MicroTime timeMicroOp(typename Op::Input *inputs, int numInputs)
+{
+    MicroTime result = { 0, 0 };
+    if (numInputs == 0)
+        return result;
+
+    int passes = MICRO_OPS / numInputs;
+    if (passes < 1)
+        passes = 1;
+
+    uint64 chainMask = microChainMask;
+    uint64 chain = 0;
+    uint64 sink = 0;
+
+    LARGE_INTEGER freq, count1, count2;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count1);
+    uint64 cycles1 = __rdtsc();
+
+    for (int p = 0; p < passes; p++)
+    {
+        for (int i = 0; i < numInputs; i++)
+        {
+            uint64 r = Op::run(&inputs[i], chain);
+            if (chained)
+                chain = r & chainMask;
+            sink += r;
+        }
+    }
+
+    uint64 cycles2 = __rdtsc();
+    QueryPerformanceCounter(&count2);
+    microSink += sink;
+
+    double ops = (double) passes * numInputs;
+    result.nsPerOp     = ((double) (count2.QuadPart - count1.QuadPart) * 1e9) / freq.QuadPart / ops;
+    result.cyclesPerOp = (double) (cycles2 - cycles1) / ops;
+    return result;
+}
+
+// the primitives, each taking an input and the chain value to fold into it
+template <int cpuTier, int sliderBackend>
+struct MicroPopCount
+{
+    typedef uint64 Input;
+    MY_INLINE static uint64 run(uint64 *x, uint64 chain) { return BitOps<cpuTier>::popCount(*x ^ chain); }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroBitScan
+{
+    typedef uint64 Input;
+    MY_INLINE static uint64 run(uint64 *x, uint64 chain) { return BitOps<cpuTier>::bitScan(*x ^ chain); }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroBishopAttacks
+{
+    typedef MicroSliderInput Input;
+    MY_INLINE static uint64 run(MicroSliderInput *in, uint64 chain)
+    {
+        return MoveGeneratorBitboardT<cpuTier, sliderBackend>::bishopAttacks(in->piece, in->pro ^ chain);
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroRookAttacks
+{
+    typedef MicroSliderInput Input;
+    MY_INLINE static uint64 run(MicroSliderInput *in, uint64 chain)
+    {
+        return MoveGeneratorBitboardT<cpuTier, sliderBackend>::rookAttacks(in->piece, in->pro ^ chain);
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroPinnedPieces
+{
+    typedef MicroPinInput Input;
+    MY_INLINE static uint64 run(MicroPinInput *in, uint64 chain)
+    {
+        return MoveGeneratorBitboardT<cpuTier, sliderBackend>::findPinnedPieces(in->myKing, in->myPieces, in->enemyBishops,
+                                                                                in->enemyRooks, in->allPieces ^ chain, in->kingIndex);
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroAttackedSquares
+{
+    typedef MicroPinInput Input;
+    MY_INLINE static uint64 run(MicroPinInput *in, uint64 chain)
+    {
+        return MoveGeneratorBitboardT<cpuTier, sliderBackend>::findAttackedSquares(~in->allPieces ^ chain, in->enemyBishops, in->enemyRooks,
+                                                                                   in->enemyPawns, in->enemyKnights, in->enemyKing,
+                                                                                   in->myKing, in->enemyColor);
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroPinnedAndAttacked
+{
+    typedef MicroPinInput Input;
+    MY_INLINE static uint64 run(MicroPinInput *in, uint64 chain)
+    {
+        uint64 pinned, attacked;
+        MoveGeneratorBitboardT<cpuTier, sliderBackend>::findPinnedAndAttacked(in->myKing, in->myPieces, in->enemyBishops, in->enemyRooks,
+                                                                              in->allPieces ^ chain, in->kingIndex, in->enemyPawns,
+                                                                              in->enemyKnights, in->enemyKing, in->enemyColor,
+                                                                              &pinned, &attacked);
+        return pinned ^ attacked;
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroMakeMove
+{
+    typedef MicroMoveInput Input;
+    MY_INLINE static uint64 run(MicroMoveInput *in, uint64 chain)
+    {
+        HexaBitBoardPosition newPos = in->pos;
+        newPos.whitePieces ^= chain;
+        uint64 hash = 0;
+        makeMove<cpuTier, sliderBackend>(&newPos, hash, in->move, newPos.chance);
+        return newPos.whitePieces ^ newPos.pawns ^ hash;
+    }
+};
+
+template <int cpuTier, int sliderBackend>
+struct MicroZobristKey
+{
+    typedef HexaBitBoardPosition Input;
+    MY_INLINE static uint64 run(HexaBitBoardPosition *pos, uint64 chain)
+    {
+        HexaBitBoardPosition newPos = *pos;
+        newPos.whitePieces ^= chain;
+        return computeZobristKey(&newPos);
+    }
+};
+
+template <template <int, int> class Op, int cpuTier, int sliderBackend>
+void printMicroOp(const char *name, const char *backendName, typename Op<cpuTier, sliderBackend>::Input *inputs, int numInputs)
+{
+    MicroTime throughput = timeMicroOp<Op<cpuTier, sliderBackend>, false>(inputs, numInputs);
+    MicroTime latency    = timeMicroOp<Op<cpuTier, sliderBackend>, true> (inputs, numInputs);
+    printf("%-22s %-24s %10.2f %10.2f %10.2f %10.2f\n", name, backendName,
+           throughput.nsPerOp, throughput.cyclesPerOp, latency.nsPerOp, latency.cyclesPerOp);
+}
+
+// the ones that don't depend on the slider backend
+template <int cpuTier, int sliderBackend>
+void microBenchCommon(MicroCorpus *corpus)
+{
+    printMicroOp<MicroPopCount,   cpuTier, sliderBackend>("popCount",          "", corpus->bitboards, corpus->numBitboards);
+    printMicroOp<MicroBitScan,    cpuTier, sliderBackend>("bitScan",           "", corpus->bitboards, corpus->numBitboards);
+    printMicroOp<MicroPinnedPieces, cpuTier, sliderBackend>("findPinnedPieces",  "", corpus->pinInputs, corpus->numPositions);
+    printMicroOp<MicroMakeMove,   cpuTier, sliderBackend>("makeMove",          "", corpus->moves,     corpus->numMoves);
+    printMicroOp<MicroZobristKey, cpuTier, sliderBackend>("computeZobristKey", "", corpus->positions, corpus->numPositions);
+}
+
+template <int cpuTier, int sliderBackend>
+void microBenchSliders(MicroCorpus *corpus)
+{
+    const char *backendName = sliderBackendNames[g_sliderBackend];
+    if (sliderBackend != SLIDER_KOGGE_STONE_SIMD)
+    {
+        printMicroOp<MicroBishopAttacks,   cpuTier, sliderBackend>("bishopAttacks",       backendName, corpus->bishops,   corpus->numBishops);
+        printMicroOp<MicroRookAttacks,     cpuTier, sliderBackend>("rookAttacks",         backendName, corpus->rooks,     corpus->numRooks);
+        printMicroOp<MicroAttackedSquares, cpuTier, sliderBackend>("findAttackedSquares", backendName, corpus->pinInputs, corpus->numPositions);
+    }
+    printMicroOp<MicroPinnedAndAttacked, cpuTier, sliderBackend>("findPinnedAndAttacked", backendName, corpus->pinInputs, corpus->numPositions);
+}
+
+void microBenchCommon(MicroCorpus *corpus)
+{
+    CALL_FOR_GENERATOR(microBenchCommon, corpus);
+}
+
+void microBenchSliders(MicroCorpus *corpus)
+{
+    CALL_FOR_GENERATOR(microBenchSliders, corpus);
+}
+
+int runMicroBench()
+{
+    static MicroCorpus corpus;
+    buildMicroCorpus(&corpus);
+
+    printf("\n%d positions, %d bitboards, %d bishops/queens, %d rooks/queens, %d moves, %s code path\n", corpus.numPositions,
+           corpus.numBitboards, corpus.numBishops, corpus.numRooks, corpus.numMoves, cpuTierNames[g_cpuTier]);
+    printf("\n                                               throughput             chained\n");
+    printf("primitive              backend                    ns/op  cycles/op      ns/op  cycles/op\n");
+
+    microBenchCommon(&corpus);
+
+    int originalBackend = g_sliderBackend;
+    for (int backend = 0; backend < NUM_SLIDER_BACKENDS; backend++)
+    {
+        if (setSliderBackend(backend) != backend)
+            continue;
+        microBenchSliders(&corpus);
+    }
+    setSliderBackend(originalBackend);
+
+    return 0;
+}
+
+#endif
@@ -1,6 +1,18 @@
 #include "chess.h"
+
+// use the lookup tables precomputed in AttackTables.h instead of building them in init()
+// (set to 0 and run perft with GENERATE_ATTACK_TABLES to regenerate AttackTables.h)
+#define USE_GENERATED_TABLES 1
+
+// copy the lookup tables read while searching into one 2 MB aligned block, backed by a huge page when possible
+// (see HotTables)
+#define USE_HOT_TABLE_ARENA 1
+
 #include "FancyMagics.h"
+#include "HugePages.h"
+#include "TableMemory.h"
 #include "randoms.h"
+#include "CpuFeatures.h"
 #include <intrin.h>
 #include <time.h>
 
@@ -15,24 +27,32 @@
 // show how much time is spent where
 #define DEBUG_PRINT_TIME_BREAKUP 0
 
-// show how many times countmoves got called (useful for testing TT usefulness)
-#define DEBUG_PRINT_UNIQUE_COUNTMOVES 0
+// sample hardware counters (cycles, instructions, branch/cache/TLB misses) around the phases of perft_bb, per depth and
+// per thread, on 1 in PHASE_SAMPLE_INTERVAL nodes (see PhaseProfile.h). Cheap enough to leave on, but not free
+// (perft_bb without USE_MOVE_LIST and perft_interleaved only)
+#define PROFILE_PHASES 0
 
+// show how many times countmoves got called (useful for testing TT usefulness)
 // print  various hash statistics
+// (both only set the default of g_perftStats: any build can print them with "perft -stats", see PerftStats.h)
+#define DEBUG_PRINT_UNIQUE_COUNTMOVES 0
 #define PRINT_HASH_STATS 0
 
 
 // first add moves to a move list and then use makeMove function to update the board
 // when this is set to 0, generateBoards is called to generate the updated boards directly
+// (this and USE_COUNT_ONLY_OPT, USE_TRANSPOSITION_TABLE, USE_DUAL_SLOT_TT, USE_SHALLOW_TT make the default variant,
+// the others compiled in can be selected at run time, see PerftVariants.h)
 #define USE_MOVE_LIST 0
 
 // make use of a hash table to avoid duplicate calculations due to transpositions
+// (the hash table code below is compiled in either way, for the engine variants that use it. This makes the default
+// variant use it, allocates the tables at startup and turns on the snapshot and the interleaved driver. Without it
+// the tables are only allocated when a variant that uses them is selected, see setPerftVariant)
 #define USE_TRANSPOSITION_TABLE 0
 
 #define EXACT_EN_PASSENT_FLAGGING 1
 
-#if USE_TRANSPOSITION_TABLE == 1
-
 // incrementally calculate zobrist hash when making a move / generating a board
 // currently only works with move list (when USE_MOVE_LIST == 1)
 // costs ~7% for CPU perft
@@ -63,6 +83,11 @@
 // remaining bits (that are stored per hash entry)
 #define TT_HASH_BITS   (ALLSET ^ TT_INDEX_BITS)
 
+// entries are tagged with the generation they were written in (see newTTGeneration), and when picking the entry to
+// replace an entry loses this much depth for every generation it is old. So the table doesn't need to be cleared
+// between records/iterations: old entries keep hitting until newer/deeper ones push them out
+#define TT_AGE_PENALTY 1
+
 // use a second transposition table for storing positions only at depth 2
 #define USE_SHALLOW_TT 1
 
@@ -81,11 +106,71 @@
 #define LEAVES_TT_INDEX_BITS   (LEAVES_TT_SIZE - 1)
 #define LEAVES_TT_HASH_BITS    (ALLSET ^ LEAVES_TT_INDEX_BITS)
 #endif
+
+// small per thread cache (direct mapped, sized to stay in L2) checked before the big tables at depths 1 - 3
+// shallow transpositions are mostly found close together in the tree, while a probe of a multi GB table is
+// almost always a DRAM miss. Stores are written through to the big tables
+#define USE_TT_CACHE 1
+
+#if USE_TT_CACHE == 1
+// 14 bits: 16K entries of 16 bytes -> 256 KB per thread
+#define TT_CACHE_BITS          14
+#define TT_CACHE_SIZE          (1 << TT_CACHE_BITS)
+#define TT_CACHE_INDEX_BITS    (TT_CACHE_SIZE - 1)
+#define TT_CACHE_MAX_DEPTH     3
+#endif
+
+// turn probing/storing the hash tables at each depth on or off at runtime (per thread), from sampled hit rates and
+// costs: a depth keeps using them while (hit rate * cycles to compute a subtree) > cycles spent on a probe
+// depths that are off don't store either, so the table space goes to the depths that actually save work
+// (this also makes it safe to compile in USE_TRANSPOSITION_AT_LEAVES, depth 1 gets turned off if it doesn't pay)
+// (perft_bb without USE_MOVE_LIST and perft_interleaved only)
+#define USE_ADAPTIVE_TT 1
+
+#if USE_ADAPTIVE_TT == 1
+// 1 in this many nodes at a depth is timed
+#define TT_SAMPLE_INTERVAL     64
+// the policy of a depth is revisited every this many nodes at that depth
+#define TT_POLICY_WINDOW       (1 << 16)
+// a depth that was turned off is tried again after this many windows
+#define TT_POLICY_RETRY        16
+#endif
+
+#if USE_TRANSPOSITION_TABLE == 1
+// init() maps the hash tables from this file if there is one written with the same setup (see TTSnapshot.h),
+// and saveTTSnapshot() writes them to it - so that restarted/follow-on runs begin with a warm table
+#define USE_TT_SNAPSHOT 1
+
+#if USE_TT_SNAPSHOT == 1
+#define TT_SNAPSHOT_FILE       "perft_tt.bin"
+// seconds between snapshots while running a work unit in perft verification mode
+#define TT_SNAPSHOT_INTERVAL   1800
+#endif
+
+// perft_interleaved(): each thread walks several subtrees at once and switches between them on every hash probe,
+// so that the probes (prefetched) overlap with move generation instead of stalling (see InterleavedPerft.h)
+// used by the drivers in perft.cpp in place of perft_bb
+#define USE_INTERLEAVED_PERFT 1
 #endif
 
 // only count moves at leaves (instead of generating/making them)
 #define USE_COUNT_ONLY_OPT 1
 
+// the last FIXED_DEPTH_PLIES (2 or 3) plies by templates on depth and side to move, without the depth tests and
+// the hash table code of perft_bb (only below the depths that probe the hash tables, see FixedDepthPerft.h)
+#define USE_FIXED_DEPTH_PERFT 1
+#define FIXED_DEPTH_PLIES 3
+
+// look up nodes at depth >= RESULT_STORE_MIN_DEPTH in the permanent result store (ResultStore.h) before searching
+// them, and add them to it after. Only when the driver has opened one (openResultStore)
+// (perft_bb without USE_MOVE_LIST and perft_interleaved only)
+#define USE_RESULT_STORE 1
+
+#if USE_RESULT_STORE == 1
+#define RESULT_STORE_FILE       "perft_results.bin"
+#define RESULT_STORE_MIN_DEPTH  6
+#endif
+
 // move generation functions templated on chance
 #define USE_TEMPLATE_CHANCE_OPT 1
 
@@ -101,6 +186,11 @@
 // pentium 4 doesn't have fast HW bitscan
 #define USE_HW_BITSCAN 1
 
+// detect popcnt/bmi/avx2/avx-512 at startup and run the generator instantiated for the best of them
+// (USE_POPCNT is then only used for the generic code that isn't part of the perft hot path)
+// set to 0 to build a binary for a single cpu type as selected by USE_POPCNT/USE_HW_BITSCAN
+#define USE_RUNTIME_CPU_DISPATCH 1
+
 // use lookup tabls for figuring out squares in line and squares in between
 #define USE_IN_BETWEEN_LUT 1
     
@@ -126,6 +216,50 @@
 // >10% slower than fixed shift fancy magics on both CPU and GPU
 #define USE_BYTE_LOOKUP_FANCY 0
 
+// use BMI2 pext instruction to index dense per-square lookup tables (~840 KB)
+// no multiply and no holes in the tables, picked by default on cpus with fast pext (unless the kogge-stone simd
+// backend is, see below)
+// (amd cpus before zen 3 implement pext in microcode and are better off with fancy magics)
+#define USE_PEXT_WHEN_AVAILABLE 1
+
+// find squares attacked by enemy sliders and pinned pieces with a single kogge-stone pass over
+// all 8 directions in parallel simd lanes (avx2/avx-512 instances of the kogge-stone simd backend, see KoggeStoneSimd.h)
+#define USE_SIMD_KOGGE_STONE 1
+
+// count the moves of the children of leaf-parent nodes 4 (avx2) or 8 (avx-512) positions at a time
+// (avx2/avx-512 instances of the kogge-stone simd backend, see CountMovesBatch.h)
+#define USE_BATCHED_LEAF_COUNT 1
+
+// sliding piece attack generators (all of them are compiled in and can be selected at run time)
+#define SLIDER_FANCY_MAGICS     0
+#define SLIDER_PLAIN_MAGICS     1
+#define SLIDER_BYTE_LOOKUP      2
+#define SLIDER_KOGGE_STONE      3
+#define SLIDER_PEXT             4
+#define SLIDER_HYPERBOLA        5       // hyperbola quintessence
+#define SLIDER_OBSTRUCTION_DIFF 6       // obstruction difference
+#define SLIDER_KOGGE_STONE_SIMD 7       // the simd passes above, fancy magics for the attacks of single pieces
+#define NUM_SLIDER_BACKENDS     8
+
+// the generator used unless something else is selected with setSliderBackend()
+#if USE_SLIDING_LUT != 1
+#define DEFAULT_SLIDER_BACKEND SLIDER_KOGGE_STONE
+#elif USE_FANCY_MAGICS != 1
+#define DEFAULT_SLIDER_BACKEND SLIDER_PLAIN_MAGICS
+#elif USE_BYTE_LOOKUP_FANCY == 1
+#define DEFAULT_SLIDER_BACKEND SLIDER_BYTE_LOOKUP
+#else
+#define DEFAULT_SLIDER_BACKEND SLIDER_FANCY_MAGICS
+#endif
+
+static const char *sliderBackendNames[NUM_SLIDER_BACKENDS] = { "fancy magics", "plain magics", "byte lookup", "kogge-stone", "pext",
+                                                                "hyperbola quintessence", "obstruction difference", "kogge-stone simd" };
+// for the command line ("perft -backend <name> ...")
+static const char *sliderBackendOptions[NUM_SLIDER_BACKENDS] = { "fancy", "plain", "byte", "kogge-stone", "pext", "hyperbola",
+                                                                  "obstruction", "simd" };
+
+static int g_sliderBackend = DEFAULT_SLIDER_BACKEND;
+
 // bit board constants
 #define C64(constantU64) constantU64##ULL
 
@@ -179,7 +313,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint8 popCount(uint64 x)
 {
 #ifdef __CUDA_ARCH__
     return __popcll(x);
-#elif USE_POPCNT == 1
+#elif USE_POPCNT == 1 && USE_RUNTIME_CPU_DISPATCH == 0
 #ifdef _WIN64
     return _mm_popcnt_u64(x);
 #else
@@ -254,6 +388,131 @@ CUDA_CALLABLE_MEMBER /*MY_INLINE*/ uint8 bitScan(uint64 x)
 #endif
 }
 
+// return the index of the most significant set bit
+CUDA_CALLABLE_MEMBER MY_INLINE uint8 bitScanReverse(uint64 x)
+{
+    assert(x != 0);
+#ifdef __CUDA_ARCH__
+    return 63 - __clzll(x);
+#elif USE_HW_BITSCAN == 1 && defined(_WIN64)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, x);
+    return (uint8) index;
+#else
+    uint8 index = 0;
+    if (x >> 32) { x >>= 32; index += 32; }
+    if (x >> 16) { x >>= 16; index += 16; }
+    if (x >> 8)  { x >>= 8;  index += 8;  }
+    if (x >> 4)  { x >>= 4;  index += 4;  }
+    if (x >> 2)  { x >>= 2;  index += 2;  }
+    if (x >> 1)  {           index += 1;  }
+    return index;
+#endif
+}
+
+// mirror the board vertically (rank 1 <-> rank 8)
+CUDA_CALLABLE_MEMBER MY_INLINE uint64 flipVertical(uint64 x)
+{
+#ifdef __CUDA_ARCH__
+    return ((uint64) __byte_perm(HI(x), 0, 0x0123)) | (((uint64) __byte_perm(LO(x), 0, 0x0123)) << 32);
+#else
+    return _byteswap_uint64(x);
+#endif
+}
+
+// the instruction set the generator gets compiled for when run time dispatch is disabled
+#if USE_POPCNT == 1
+#define CPU_TIER_STATIC CPU_TIER_POPCNT
+#else
+#define CPU_TIER_STATIC CPU_TIER_GENERIC
+#endif
+
+// bit twiddling primitives used by the move generator, specialized for the given cpu tier
+// (the intrinsics are only executed by instantiations for tiers that have the instructions)
+template <int cpuTier>
+struct BitOps
+{
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint8 popCount(uint64 x)
+    {
+#if USE_RUNTIME_CPU_DISPATCH == 1 && !defined(__CUDA_ARCH__)
+        if (cpuTier >= CPU_TIER_POPCNT)
+        {
+#ifdef _WIN64
+            return (uint8) _mm_popcnt_u64(x);
+#else
+            return (uint8) (_mm_popcnt_u32(LO(x)) + _mm_popcnt_u32(HI(x)));
+#endif
+        }
+#endif
+        return ::popCount(x);
+    }
+
+    // index of the least significant set bit
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint8 bitScan(uint64 x)
+    {
+#if USE_RUNTIME_CPU_DISPATCH == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2)
+        {
+            // tzcnt doesn't have the false dependency on the destination register that bsf has
+            return (uint8) _tzcnt_u64(x);
+        }
+#endif
+        return ::bitScan(x);
+    }
+
+    // index of the most significant set bit
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint8 bitScanReverse(uint64 x)
+    {
+#if USE_RUNTIME_CPU_DISPATCH == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2)
+        {
+            return (uint8) (63 - _lzcnt_u64(x));
+        }
+#endif
+        return ::bitScanReverse(x);
+    }
+
+    // bitboard containing only the least significant set bit
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 getOne(uint64 x)
+    {
+#if USE_RUNTIME_CPU_DISPATCH == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2)
+        {
+            return _blsi_u64(x);
+        }
+#endif
+        return x & (-x);
+    }
+};
+
+// sizes and types of the lookup tables below (also used by AttackTables.h)
+#define ROOK_MAGIC_BITS    12
+#define BISHOP_MAGIC_BITS  9
+
+#define PEXT_ROOK_TABLE_SIZE    102400
+#define PEXT_BISHOP_TABLE_SIZE  5248
+
+#define OD_FILE           0
+#define OD_RANK           1
+#define OD_DIAGONAL       2
+#define OD_ANTI_DIAGONAL  3
+
+struct ObstructionLine
+{
+    uint64 lower;
+    uint64 upper;
+};
+
+static uint64 pawnAttacks[2] [64];
+
+// plain magic attack tables (filled by initPlainMagics only when plain magics are selected)
+uint64 rookMagicAttackTables      [64][1 << ROOK_MAGIC_BITS  ];    // 2 MB
+uint64 bishopMagicAttackTables    [64][1 << BISHOP_MAGIC_BITS];    // 256 KB
+
+#if USE_GENERATED_TABLES == 1
+#include "AttackTables.h"
+#else
+
 // bit mask containing squares between two given squares
 static uint64 Between[64][64];
 
@@ -266,13 +525,9 @@ static uint64 BishopAttacks  [64];
 static uint64 QueenAttacks   [64];
 static uint64 KingAttacks    [64];
 static uint64 KnightAttacks  [64];
-static uint64 pawnAttacks[2] [64];
 
 // magic lookup tables
 // plain magics (Fancy magic lookup tables in FancyMagics.h)
-#define ROOK_MAGIC_BITS    12
-#define BISHOP_MAGIC_BITS  9
-
 uint64 rookMagics            [64];
 uint64 bishopMagics          [64];
 
@@ -280,8 +535,118 @@ uint64 bishopMagics          [64];
 static uint64 RookAttacksMasked   [64];
 static uint64 BishopAttacksMasked [64];
 
-uint64 rookMagicAttackTables      [64][1 << ROOK_MAGIC_BITS  ];    // 2 MB
-uint64 bishopMagicAttackTables    [64][1 << BISHOP_MAGIC_BITS];    // 256 KB
+// pext lookup tables
+// every square gets 2^(no of relevant occupancy bits) entries, indexed by pext(occupancy, mask)
+uint64 pextAttackTable[PEXT_ROOK_TABLE_SIZE + PEXT_BISHOP_TABLE_SIZE];      // 841 KB
+uint32 pextRookOffset  [64];
+uint32 pextBishopOffset[64];
+
+// hyperbola quintessence and obstruction difference tables (2 KB and 4 KB - nothing else competing for L1)
+// lines through each square (the square itself excluded)
+static uint64 FileMaskEx        [64];
+static uint64 DiagonalMaskEx    [64];
+static uint64 AntiDiagonalMaskEx[64];
+
+// attacks of a slider on the first rank, indexed by inner 6 bits of the rank occupancy and file of the slider
+// (byte swapping doesn't reverse ranks so hyperbola quintessence needs this for rook moves along ranks)
+static uint8  FirstRankAttacks[64][8];
+
+// the four lines through a square (OD_FILE, etc), split into squares below and above it
+static ObstructionLine ObstructionLines[64][4];
+
+#endif // #if USE_GENERATED_TABLES == 1
+
+#if USE_HOT_TABLE_ARENA == 1
+// the tables above are spread over ~2 MB in 4 KB pages, which costs a lot of dTLB misses in countMoves
+// this is a copy of all of them that the cpu generator reads (~1.9 MB), packed in one 2 MB page
+// ordered by how often they are accessed: the small per-node tables share the first few cache lines
+// and the big slider tables come last (only the ones of the selected slider backend are ever touched)
+struct HotTables
+{
+    // every node
+    uint64 KingAttacks         [64];
+    uint64 KnightAttacks       [64];
+    uint64 RookAttacksMasked   [64];
+    uint64 BishopAttacksMasked [64];
+    FancyMagicEntry rook_magics_fancy  [64];
+    FancyMagicEntry bishop_magics_fancy[64];
+    uint32 pextRookOffset      [64];
+    uint32 pextBishopOffset    [64];
+    uint64 RookAttacks         [64];
+    uint64 BishopAttacks       [64];
+
+    // pinned pieces and check evasions
+    uint64 Line   [64][64];
+    uint64 Between[64][64];
+
+    // hyperbola quintessence and obstruction difference
+    uint64 FileMaskEx        [64];
+    uint64 DiagonalMaskEx    [64];
+    uint64 AntiDiagonalMaskEx[64];
+    uint8  FirstRankAttacks  [64][8];
+    ObstructionLine ObstructionLines[64][4];
+
+    // sliding piece attack lookups
+    uint64 pextAttackTable[PEXT_ROOK_TABLE_SIZE + PEXT_BISHOP_TABLE_SIZE];
+    uint64 fancy_magic_lookup_table[97264];
+    uint64 fancy_byte_RookLookup   [4900];
+    uint64 fancy_byte_BishopLookup [1428];
+    uint8  fancy_byte_magic_lookup_table[97264];
+};
+
+static HotTables *hotTables = NULL;
+static int hotTablesPageType = PAGES_SMALL;
+
+#define HOT_TABLE(table) (hotTables->table)
+
+#define COPY_HOT_TABLE(table) memcpy(tables->table, table, sizeof(tables->table))
+
+// (re)build the packed copy of the tables
+// hugePages == false is only useful to measure the difference huge pages make
+void initHotTables(bool hugePages)
+{
+    int pageType;
+    HotTables *tables = (HotTables *) allocPages(sizeof(HotTables), hugePages, &pageType);
+    if (tables == NULL)
+    {
+        printf("\nFailed to allocate %d bytes for lookup tables\n", (int) sizeof(HotTables));
+        return;
+    }
+
+    COPY_HOT_TABLE(KingAttacks);
+    COPY_HOT_TABLE(KnightAttacks);
+    COPY_HOT_TABLE(RookAttacksMasked);
+    COPY_HOT_TABLE(BishopAttacksMasked);
+    COPY_HOT_TABLE(rook_magics_fancy);
+    COPY_HOT_TABLE(bishop_magics_fancy);
+    COPY_HOT_TABLE(pextRookOffset);
+    COPY_HOT_TABLE(pextBishopOffset);
+    COPY_HOT_TABLE(RookAttacks);
+    COPY_HOT_TABLE(BishopAttacks);
+    COPY_HOT_TABLE(Line);
+    COPY_HOT_TABLE(Between);
+    COPY_HOT_TABLE(FileMaskEx);
+    COPY_HOT_TABLE(DiagonalMaskEx);
+    COPY_HOT_TABLE(AntiDiagonalMaskEx);
+    COPY_HOT_TABLE(FirstRankAttacks);
+    COPY_HOT_TABLE(ObstructionLines);
+    COPY_HOT_TABLE(pextAttackTable);
+    COPY_HOT_TABLE(fancy_magic_lookup_table);
+    COPY_HOT_TABLE(fancy_byte_RookLookup);
+    COPY_HOT_TABLE(fancy_byte_BishopLookup);
+    COPY_HOT_TABLE(fancy_byte_magic_lookup_table);
+
+    freePages(hotTables, sizeof(HotTables));
+    hotTables = tables;
+    hotTablesPageType = pageType;
+}
+#else
+#define HOT_TABLE(table) (table)
+#endif
+
+// whether the (plain magics and pext) tables which aren't built by default have been initialized
+static bool plainMagicsInitialized = false;
+static bool pextTablesInitialized  = (USE_GENERATED_TABLES == 1);
 
 
 uint64 findRookMagicForSquare  (int square, uint64 magicAttackTable[], uint64 magic = 0, uint64 *uniqueAttackTable = NULL, uint8 *byteIndices = NULL, int *numUniqueAttacks = 0);
@@ -291,6 +656,17 @@ uint64 findBishopMagicForSquare(int square, uint64 magicAttackTable[], uint64 ma
 static ZobristRandoms zob;
 static ZobristRandoms zob2;
 
+// identifies a set of random numbers, for files with hash keys in them
+uint64 zobristChecksum(const ZobristRandoms &keys)
+{
+    const uint64 *values = (const uint64 *) &keys;
+    uint64 sum = 0;
+    int n = sizeof(keys) / sizeof(uint64);
+    for (int i = 0; i < n; i++)
+        sum = (sum ^ values[i]) * 0x100000001B3ull;
+    return sum;
+}
+
 
 #if USE_DUAL_SLOT_TT == 1
 #define TT_Entry DualHashEntry
@@ -302,6 +678,163 @@ static TT_Entry *TranspositionTable;
 static uint64   *ShallowTT;
 static uint64   *LeavesTT;
 
+// which parts of the above have been faulted in yet (see TableMemory.h)
+static HashTableInfo TTInfo;
+static HashTableInfo ShallowTTInfo;
+static HashTableInfo LeavesTTInfo;
+
+// depth and generation are stored in the bits of the hash key implied by the index (see HashEntryPerft)
+CT_ASSERT(TT_BITS >= 16);
+
+// generation stored with new TranspositionTable entries (0 is never used, it's what empty entries have)
+static volatile uint8 ttGeneration = 1;
+
+#if USE_TT_CACHE == 1
+// the full hash key is kept, so entries never need to be invalidated (perft values don't change)
+struct TTCacheEntry
+{
+    uint64 hashKey;
+    uint64 perftVal;
+};
+
+static THREAD_LOCAL TTCacheEntry ttCache[TT_CACHE_SIZE];
+#endif
+
+#if USE_ADAPTIVE_TT == 1
+// samples of the current window for a depth (zero initialized, i.e, all depths start with the hash tables on)
+struct TTDepthPolicy
+{
+    bool   disabled;
+    uint32 windowsDisabled;
+    uint64 visits;
+    uint64 probes;
+    uint64 hits;
+    uint64 probeCycles;     // hash key computation + probe
+    uint64 probeSamples;
+    uint64 subtreeCycles;   // the work a hit would have saved
+    uint64 subtreeSamples;
+};
+
+static THREAD_LOCAL TTDepthPolicy ttDepthPolicy[MAX_GAME_LENGTH];
+
+// decide about the next window from the samples of the last one
+void updateTTDepthPolicy(TTDepthPolicy *policy)
+{
+    if (policy->disabled)
+    {
+        // the hit rate changes over time (e.g, with a new record), so try again now and then
+        if (++policy->windowsDisabled >= TT_POLICY_RETRY)
+            policy->disabled = false;
+    }
+    else if (policy->probes && policy->probeSamples && policy->subtreeSamples)
+    {
+        double hitRate     = (double) policy->hits / policy->probes;
+        double savedCycles = hitRate * policy->subtreeCycles / policy->subtreeSamples;
+        double probeCycles = (double) policy->probeCycles / policy->probeSamples;
+        if (savedCycles < probeCycles)
+        {
+            policy->disabled = true;
+            policy->windowsDisabled = 0;
+        }
+    }
+
+    policy->probes = policy->hits = 0;
+    policy->probeCycles = policy->probeSamples = 0;
+    policy->subtreeCycles = policy->subtreeSamples = 0;
+}
+
+// called on every node at the depth, returns the start time if this node is to be timed (0 otherwise)
+MY_INLINE uint64 ttSampleStart(TTDepthPolicy *policy)
+{
+    uint64 visits = ++policy->visits;
+    if ((visits & (TT_POLICY_WINDOW - 1)) == 0)
+        updateTTDepthPolicy(policy);
+    return (visits & (TT_SAMPLE_INTERVAL - 1)) == 0 ? __rdtsc() : 0;
+}
+
+MY_INLINE void ttSampleProbe(TTDepthPolicy *policy, uint64 start, bool hit)
+{
+    policy->probes++;
+    policy->hits += hit;
+    if (start)
+    {
+        policy->probeCycles += __rdtsc() - start;
+        policy->probeSamples++;
+    }
+}
+
+MY_INLINE void ttSampleSubtree(TTDepthPolicy *policy, uint64 start)
+{
+    if (start)
+    {
+        policy->subtreeCycles += __rdtsc() - start;
+        policy->subtreeSamples++;
+    }
+}
+#endif
+
+// call before starting a new perft (a record in verification mode, or the next depth)
+void newTTGeneration()
+{
+    uint8 generation = ttGeneration + 1;
+    ttGeneration = generation ? generation : 1;
+}
+
+// empty the hash tables (and the cache and depth policies of the calling thread), for measurements that must not
+// depend on what was searched before them (bench mode). Waits for the tables to be faulted in first
+void clearTT()
+{
+    HashTableInfo *infos[] = { &TTInfo, &ShallowTTInfo, &LeavesTTInfo };
+    for (int i = 0; i < 3; i++)
+    {
+        if (!infos[i]->mem)
+            continue;
+        while (!infos[i]->ready)
+            Sleep(1);
+        zeroTable(infos[i]->mem, infos[i]->size);
+    }
+#if USE_TT_CACHE == 1
+    memset(ttCache, 0, sizeof(ttCache));
+#endif
+#if USE_ADAPTIVE_TT == 1
+    memset(ttDepthPolicy, 0, sizeof(ttDepthPolicy));
+#endif
+}
+
+// huge pages, spread over numa nodes and faulted in by background threads (see TableMemory.h)
+// (once, by init() or by the first setPerftVariant() that selects a variant using them)
+void allocTranspositionTables()
+{
+    if (TranspositionTable)
+        return;
+
+    TranspositionTable = (TT_Entry *) allocHashTable(TT_SIZE * sizeof(TT_Entry), "transposition table", &TTInfo);
+
+#if USE_SHALLOW_TT == 1
+    ShallowTT = (uint64*) allocHashTable(SHALLOW_TT_SIZE * sizeof(uint64), "ShallowTT transposition table", &ShallowTTInfo);
+#endif
+
+#if USE_TRANSPOSITION_AT_LEAVES
+    LeavesTT = (uint64*) allocHashTable(LEAVES_TT_SIZE * sizeof(uint64), "LeavesTT transposition table", &LeavesTTInfo);
+#endif
+}
+
+#if USE_TRANSPOSITION_TABLE == 1 && USE_TT_SNAPSHOT == 1
+#include "TTSnapshot.h"
+#endif
+
+#if USE_RESULT_STORE == 1
+#include "ResultStore.h"
+#endif
+
+#if PROFILE_PHASES == 1
+#include "PhaseProfile.h"
+#else
+#define PHASE_BEGIN(depth)
+#define PHASE_MARK(phase)
+#define PHASE_SKIP()
+#endif
+
 #if TEST_GPU_PERFT == 1
 // gpu version of the above data structures
 // accessed for read only using __ldg() function
@@ -348,7 +881,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqsInBetweenLUT(uint8 sq1, uint8 sq2)
 #ifdef __CUDA_ARCH__
     return __ldg(&gBetween[sq1][sq2]);
 #else
-    return Between[sq1][sq2];
+    return HOT_TABLE(Between)[sq1][sq2];
 #endif
 }
 
@@ -357,7 +890,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqsInLineLUT(uint8 sq1, uint8 sq2)
 #ifdef __CUDA_ARCH__
     return __ldg(&gLine[sq1][sq2]);
 #else
-    return Line[sq1][sq2];
+    return HOT_TABLE(Line)[sq1][sq2];
 #endif
 }
 
@@ -366,7 +899,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqKnightAttacks(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gKnightAttacks[sq]);
 #else
-    return KnightAttacks[sq];
+    return HOT_TABLE(KnightAttacks)[sq];
 #endif
 }
 
@@ -375,7 +908,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqKingAttacks(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gKingAttacks[sq]);
 #else
-    return KingAttacks[sq];
+    return HOT_TABLE(KingAttacks)[sq];
 #endif
 }
 
@@ -384,7 +917,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqRookAttacks(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gRookAttacks[sq]);
 #else
-    return RookAttacks[sq];
+    return HOT_TABLE(RookAttacks)[sq];
 #endif
 }
 
@@ -393,7 +926,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqBishopAttacks(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gBishopAttacks[sq]);
 #else
-    return BishopAttacks[sq];
+    return HOT_TABLE(BishopAttacks)[sq];
 #endif
 }
 
@@ -402,7 +935,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqBishopAttacksMasked(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gBishopAttacksMasked[sq]);
 #else
-    return BishopAttacksMasked[sq];
+    return HOT_TABLE(BishopAttacksMasked)[sq];
 #endif
 }
 
@@ -411,7 +944,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqRookAttacksMasked(uint8 sq)
 #ifdef __CUDA_ARCH__
     return __ldg(&gRookAttacksMasked[sq]);
 #else
-    return RookAttacksMasked[sq];
+    return HOT_TABLE(RookAttacksMasked)[sq];
 #endif
 }
 
@@ -456,7 +989,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sq_fancy_magic_lookup_table(int index)
 #ifdef __CUDA_ARCH__
     return __ldg(&g_fancy_magic_lookup_table[index]);
 #else
-    return fancy_magic_lookup_table[index];
+    return HOT_TABLE(fancy_magic_lookup_table)[index];
 #endif
 }
 
@@ -467,7 +1000,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE FancyMagicEntry sq_bishop_magics_fancy(int sq)
     op.data = __ldg(&(((uint4 *)g_bishop_magics_fancy)[sq]));
     return op;
 #else
-    return bishop_magics_fancy[sq];
+    return HOT_TABLE(bishop_magics_fancy)[sq];
 #endif
 }
 
@@ -478,7 +1011,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE FancyMagicEntry sq_rook_magics_fancy(int sq)
     op.data = __ldg(&(((uint4 *)g_rook_magics_fancy)[sq]));
     return op;
 #else
-    return rook_magics_fancy[sq];
+    return HOT_TABLE(rook_magics_fancy)[sq];
 #endif
 }
 
@@ -487,7 +1020,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint8 sq_fancy_byte_magic_lookup_table(int index)
 #ifdef __CUDA_ARCH__
     return __ldg(&g_fancy_byte_magic_lookup_table[index]);
 #else
-    return fancy_byte_magic_lookup_table[index];
+    return HOT_TABLE(fancy_byte_magic_lookup_table)[index];
 #endif
 }
 
@@ -496,7 +1029,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sq_fancy_byte_BishopLookup(int index)
 #ifdef __CUDA_ARCH__
     return __ldg(&g_fancy_byte_BishopLookup[index]);
 #else
-    return fancy_byte_BishopLookup[index];
+    return HOT_TABLE(fancy_byte_BishopLookup)[index];
 #endif
 }
 
@@ -505,14 +1038,46 @@ CUDA_CALLABLE_MEMBER MY_INLINE uint64 sq_fancy_byte_RookLookup(int index)
 #ifdef __CUDA_ARCH__
     return __ldg(&g_fancy_byte_RookLookup[index]);
 #else
-    return fancy_byte_RookLookup[index];
+    return HOT_TABLE(fancy_byte_RookLookup)[index];
 #endif
 }
 
-class MoveGeneratorBitboard
+// pext is a cpu only thing
+CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqPextRookAttacks(uint8 sq, uint64 index)
+{
+    return HOT_TABLE(pextAttackTable)[HOT_TABLE(pextRookOffset)[sq] + index];
+}
+
+CUDA_CALLABLE_MEMBER MY_INLINE uint64 sqPextBishopAttacks(uint8 sq, uint64 index)
+{
+    return HOT_TABLE(pextAttackTable)[HOT_TABLE(pextBishopOffset)[sq] + index];
+}
+
+#include "KoggeStoneSimd.h"
+
+// sliding piece attack generator policies (one specialization per SLIDER_* backend, defined after the generator)
+// interface:
+// bishopAttacks/rookAttacks(piece, pro)            - attacks of a single piece, pro = empty squares
+// multiBishopAttacks/multiRookAttacks(pieces, pro) - combined attacks of a set of pieces
+template <int sliderBackend, int cpuTier>
+struct SliderAttacks;
+
+template <int cpuTier, int sliderBackend>
+class MoveGeneratorBitboardT
 {
 public:
 
+    // popCount and bitScan calls in the generator resolve to these (and not the global versions)
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint8 popCount(uint64 x)
+    {
+        return BitOps<cpuTier>::popCount(x);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint8 bitScan(uint64 x)
+    {
+        return BitOps<cpuTier>::bitScan(x);
+    }
+
     // move the bits in the bitboard one square in the required direction
 
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 northOne(uint64 x)
@@ -792,116 +1357,30 @@ public:
     }
 
 
-#if USE_SLIDING_LUT == 1
+    // sliding piece attacks for the slider backend this instance of the generator is compiled for
+    // (see SliderAttacks below)
+    // pro - empty squares
+
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
     {
-        uint8 square = bitScan(bishop);
-        uint64 occ = (~pro) & sqBishopAttacksMasked(square);
-
-#if USE_FANCY_MAGICS == 1
-#ifdef __CUDA_ARCH__
-        FancyMagicEntry magicEntry = sq_bishop_magics_fancy(square);
-        int index = (magicEntry.factor * occ) >> (64 - BISHOP_MAGIC_BITS);
-
-#if USE_BYTE_LOOKUP_FANCY == 1
-        int index2 = sq_fancy_byte_magic_lookup_table(magicEntry.position + index) + magicEntry.offset;
-        return sq_fancy_byte_BishopLookup(index2);
-#else // USE_BYTE_LOOKUP_FANCY == 1
-        return sq_fancy_magic_lookup_table(magicEntry.position + index);
-#endif // USE_BYTE_LOOKUP_FANCY == 1
-
-#else // #ifdef __CUDA_ARCH__
-        // this version is slightly faster for CPUs.. why ?
-        uint64 magic  = bishop_magics_fancy[square].factor;
-        uint64 index = (magic * occ) >> (64 - BISHOP_MAGIC_BITS);
-#if USE_BYTE_LOOKUP_FANCY == 1
-        uint8 *table = &fancy_byte_magic_lookup_table[bishop_magics_fancy[square].position];
-        int index2 = table[index] + bishop_magics_fancy[square].offset;
-        return fancy_byte_BishopLookup[index2];
-#else // USE_BYTE_LOOKUP_FANCY == 1
-        uint64 *table = &fancy_magic_lookup_table[bishop_magics_fancy[square].position];
-        return table[index];
-#endif // USE_BYTE_LOOKUP_FANCY == 1
-#endif // #ifdef __CUDA_ARCH__
-#else // USE_FANCY_MAGICS == 1
-        uint64 magic = sqBishopMagics(square);
-        uint64 index = (magic * occ) >> (64 - BISHOP_MAGIC_BITS);
-        return sqBishopMagicAttackTables(square, index);
-#endif // USE_FANCY_MAGICS == 1
+        return SliderAttacks<sliderBackend, cpuTier>::bishopAttacks(bishop, pro);
     }
 
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
     {
-        uint8 square = bitScan(rook);
-        uint64 occ = (~pro) & sqRookAttacksMasked(square);
-
-#if USE_FANCY_MAGICS == 1
-#ifdef __CUDA_ARCH__
-        FancyMagicEntry magicEntry = sq_rook_magics_fancy(square);
-        int index = (magicEntry.factor * occ) >> (64 - ROOK_MAGIC_BITS);
-#if USE_BYTE_LOOKUP_FANCY == 1
-        int index2 = sq_fancy_byte_magic_lookup_table(magicEntry.position + index) + magicEntry.offset;
-        return sq_fancy_byte_RookLookup(index2);
-#else
-        return sq_fancy_magic_lookup_table(magicEntry.position + index);
-#endif
-
-#else
-        // this version is slightly faster for CPUs.. why ?
-        uint64 magic  = rook_magics_fancy[square].factor;
-        uint64 index = (magic * occ) >> (64 - ROOK_MAGIC_BITS);
-#if USE_BYTE_LOOKUP_FANCY == 1
-        uint8 *table = &fancy_byte_magic_lookup_table[rook_magics_fancy[square].position];
-        int index2 = table[index] + rook_magics_fancy[square].offset;
-        return fancy_byte_RookLookup[index2];
-#else
-        uint64 *table = &fancy_magic_lookup_table[rook_magics_fancy[square].position];
-        return table[index];
-#endif
-#endif
-#else
-        uint64 magic = sqRookMagics(square);
-        uint64 index = (magic * occ) >> (64 - ROOK_MAGIC_BITS);
-        return sqRookMagicAttackTables(square, index);
-#endif
+        return SliderAttacks<sliderBackend, cpuTier>::rookAttacks(rook, pro);
     }
 
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiBishopAttacks(uint64 bishops, uint64 pro)
     {
-        uint64 attacks = 0;
-        while(bishops)
-        {
-            uint64 bishop = getOne(bishops);
-            attacks |= bishopAttacks(bishop, pro);
-            bishops ^= bishop;
-        }
-
-        return attacks;
+        return SliderAttacks<sliderBackend, cpuTier>::multiBishopAttacks(bishops, pro);
     }
 	
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiRookAttacks(uint64 rooks, uint64 pro)
     {
-        uint64 attacks = 0;
-        while(rooks)
-        {
-            uint64 rook = getOne(rooks);
-            attacks |= rookAttacks(rook, pro);
-            rooks ^= rook;
-        }
-
-        return attacks;
+        return SliderAttacks<sliderBackend, cpuTier>::multiRookAttacks(rooks, pro);
     }
 
-#else
-// kogge stone handles multiple attackers automatically
-
-#define bishopAttacks bishopAttacksKoggeStone
-#define rookAttacks   rookAttacksKoggeStone
-
-#define multiBishopAttacks bishopAttacksKoggeStone
-#define multiRookAttacks   rookAttacksKoggeStone
-#endif
-
 CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
 {
 	uint64 attacks = 0;
@@ -950,7 +1429,7 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
     // returns a bitboard containing that bit
     CUDA_CALLABLE_MEMBER MY_INLINE static uint64 getOne(uint64 x)
     {
-        return x & (-x);
+        return BitOps<cpuTier>::getOne(x);
     }
 
     CUDA_CALLABLE_MEMBER MY_INLINE static bool isMultiple(uint64 x)
@@ -1047,40 +1526,24 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
 
     static void init()
     {
+        // figure out which instantiation of the generator to use
+        detectCpuFeatures();
+
         // initialize zobrist keys
         memcpy(&zob, &randoms[77], sizeof(zob));
         memcpy(&zob2, &randoms[1077], sizeof(zob2));
 
         // allocate the transposition table
 #if USE_TRANSPOSITION_TABLE == 1
-        TranspositionTable = (TT_Entry *) malloc(TT_SIZE * sizeof(TT_Entry));
-        if (TranspositionTable == NULL)
-        {
-            printf("\nFailed to allocate transposition table of %d bytes\n", TT_SIZE * sizeof(TT_Entry));
-        }
-        memset(TranspositionTable, 0, TT_SIZE * sizeof(TT_Entry));
-
-#if USE_SHALLOW_TT == 1
-        ShallowTT = (uint64*) malloc(SHALLOW_TT_SIZE * sizeof(uint64));
-        if (ShallowTT == NULL)
-        {
-            printf("\nFailed to allocate ShallowTT transposition table of %d bytes\n", SHALLOW_TT_SIZE * sizeof(uint64));
-        }
-        memset(ShallowTT, 0, SHALLOW_TT_SIZE * sizeof(uint64));
-
+#if USE_TT_SNAPSHOT == 1
+        if (!loadTTSnapshot(TT_SNAPSHOT_FILE))
 #endif
-
-#if USE_TRANSPOSITION_AT_LEAVES
-        LeavesTT = (uint64*) malloc(LEAVES_TT_SIZE * sizeof(uint64));
-        if (LeavesTT == NULL)
         {
-            printf("\nFailed to allocate LeavesTT transposition table of %d bytes\n", LEAVES_TT_SIZE * sizeof(uint64));
+            allocTranspositionTables();
         }
-        memset(LeavesTT, 0, LEAVES_TT_SIZE * sizeof(uint64));
-#endif
-
 #endif 
 
+#if USE_GENERATED_TABLES != 1
         // initialize the empty board attack tables
         for (uint8 i=0; i < 64; i++)
         {
@@ -1118,8 +1581,6 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
 
 
         // initialize magic lookup tables
-#if USE_SLIDING_LUT == 1
-        srand (time(NULL));
         for (int square = A1; square <= H8; square++)
         {
             uint64 thisSquare = BIT(square);
@@ -1142,10 +1603,6 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
 
             mask = sqBishopAttacks(square)  & (~thisSquare) & CENTRAL_SQUARES;
             BishopAttacksMasked[square] = mask;
-#if USE_FANCY_MAGICS != 1
-            rookMagics  [square] = findRookMagicForSquare  (square, rookMagicAttackTables  [square]);
-            bishopMagics[square] = findBishopMagicForSquare(square, bishopMagicAttackTables[square]);
-#endif
         }
 
         // initialize fancy magic lookup table
@@ -1165,16 +1622,82 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
                                                            &fancy_byte_BishopLookup[globalOffsetBishop], &fancy_byte_magic_lookup_table[bishop_magics_fancy[square].position], &uniqueBishopAttacks);
             assert(bishopMagic == bishop_magics_fancy[square].factor);
 
-            rook_magics_fancy  [square].offset = globalOffsetRook;
+            assert(rook_magics_fancy  [square].offset == globalOffsetRook);
             globalOffsetRook += uniqueRookAttacks;
 
-            bishop_magics_fancy[square].offset = globalOffsetBishop;
+            assert(bishop_magics_fancy[square].offset == globalOffsetBishop);
             globalOffsetBishop += uniqueBishopAttacks;
         }
 
         printf("\ntotal bishop unique attacks: %d\n", globalOffsetBishop);
         printf("\ntotal rook unique attacks: %d\n", globalOffsetRook);
-#endif        
+
+        // line masks for hyperbola quintessence and obstruction difference
+        for (int square = A1; square <= H8; square++)
+        {
+            uint64 thisSquare = BIT(square);
+            uint64 south     = southAttacks    (thisSquare, ALLSET);
+            uint64 north     = northAttacks    (thisSquare, ALLSET);
+            uint64 west      = westAttacks     (thisSquare, ALLSET);
+            uint64 east      = eastAttacks     (thisSquare, ALLSET);
+            uint64 southWest = southWestAttacks(thisSquare, ALLSET);
+            uint64 northEast = northEastAttacks(thisSquare, ALLSET);
+            uint64 southEast = southEastAttacks(thisSquare, ALLSET);
+            uint64 northWest = northWestAttacks(thisSquare, ALLSET);
+
+            FileMaskEx        [square] = south | north;
+            DiagonalMaskEx    [square] = southWest | northEast;
+            AntiDiagonalMaskEx[square] = southEast | northWest;
+
+            ObstructionLines[square][OD_FILE]          .lower = south;
+            ObstructionLines[square][OD_FILE]          .upper = north;
+            ObstructionLines[square][OD_RANK]          .lower = west;
+            ObstructionLines[square][OD_RANK]          .upper = east;
+            ObstructionLines[square][OD_DIAGONAL]      .lower = southWest;
+            ObstructionLines[square][OD_DIAGONAL]      .upper = northEast;
+            ObstructionLines[square][OD_ANTI_DIAGONAL] .lower = southEast;
+            ObstructionLines[square][OD_ANTI_DIAGONAL] .upper = northWest;
+        }
+
+        for (int innerOcc = 0; innerOcc < 64; innerOcc++)
+        {
+            for (int file = 0; file < 8; file++)
+            {
+                uint64 occ = ((uint64) innerOcc) << 1;
+                FirstRankAttacks[innerOcc][file] = (uint8) (rookAttacksKoggeStone(BIT(file), ~occ) & RANK1);
+            }
+        }
+#endif // #if USE_GENERATED_TABLES != 1
+
+        // plain magics need to search for magics (slow unless generated) - only done when they are selected
+#if USE_FANCY_MAGICS != 1
+        initPlainMagics();
+#endif
+#if USE_GENERATED_TABLES != 1
+        // (built even without BMI2 so that the packed copy of the tables below is complete)
+        initPextTables();
+#endif
+
+#if USE_HOT_TABLE_ARENA == 1
+        initHotTables(true);
+        printf("\nlookup tables: %d KB in %s\n", (int) (sizeof(HotTables) / 1024), pageTypeNames[hotTablesPageType]);
+#endif
+
+        g_sliderBackend = DEFAULT_SLIDER_BACKEND;
+#if USE_PEXT_WHEN_AVAILABLE == 1
+        if ((g_cpuFeatures & CPU_FEATURE_FAST_PEXT) && g_cpuTier >= CPU_TIER_AVX2)
+        {
+            g_sliderBackend = SLIDER_PEXT;
+        }
+#endif
+#if USE_SIMD_KOGGE_STONE == 1 || USE_BATCHED_LEAF_COUNT == 1
+        // (the simd passes do most of the slider work, 30-45% faster than pext alone on avx-512)
+        if (g_cpuTier >= CPU_TIER_AVX2)
+        {
+            g_sliderBackend = SLIDER_KOGGE_STONE_SIMD;
+        }
+#endif
+        printf("\nusing %s for sliding piece attacks\n", sliderBackendNames[g_sliderBackend]);
 
 #if TEST_GPU_PERFT == 1
         // copy all the lookup tables from CPU's memory to GPU memory
@@ -1238,9 +1761,86 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
 #endif		
     }
 
+    // find plain magics and fill their lookup tables
+    static void initPlainMagics()
+    {
+        if (plainMagicsInitialized)
+            return;
+
+#if USE_GENERATED_TABLES != 1
+        // fixed seed so that every run finds the same magics
+        srand(1);
+#endif
+        for (int square = A1; square <= H8; square++)
+        {
+#if USE_GENERATED_TABLES == 1
+            // magics already known, just fill their attack tables
+            findRookMagicForSquare  (square, rookMagicAttackTables  [square], rookMagics  [square]);
+            findBishopMagicForSquare(square, bishopMagicAttackTables[square], bishopMagics[square]);
+#else
+            rookMagics  [square] = findRookMagicForSquare  (square, rookMagicAttackTables  [square]);
+            bishopMagics[square] = findBishopMagicForSquare(square, bishopMagicAttackTables[square]);
+#endif
+        }
+        plainMagicsInitialized = true;
+    }
+
+    // fill the dense pext lookup tables (needs the masks initialized by init())
+    static void initPextTables()
+    {
+        if (pextTablesInitialized)
+            return;
+
+#if USE_GENERATED_TABLES != 1
+        uint32 offset = 0;
+        for (int square = A1; square <= H8; square++)
+        {
+            // enumerate all subsets of the mask (carry-rippler)
+            // the i'th subset generated this way is exactly the one for which pext(occ, mask) == i
+            uint64 mask = RookAttacksMasked[square];
+            uint64 occ  = 0;
+            pextRookOffset[square] = offset;
+            do
+            {
+                pextAttackTable[offset++] = rookAttacksKoggeStone(BIT(square), ~occ);
+                occ = (occ - mask) & mask;
+            } while (occ);
+        }
+        assert(offset == PEXT_ROOK_TABLE_SIZE);
+
+        for (int square = A1; square <= H8; square++)
+        {
+            uint64 mask = BishopAttacksMasked[square];
+            uint64 occ  = 0;
+            pextBishopOffset[square] = offset;
+            do
+            {
+                pextAttackTable[offset++] = bishopAttacksKoggeStone(BIT(square), ~occ);
+                occ = (occ - mask) & mask;
+            } while (occ);
+        }
+        assert(offset == PEXT_ROOK_TABLE_SIZE + PEXT_BISHOP_TABLE_SIZE);
+#endif
+
+        pextTablesInitialized = true;
+    }
+
     static void destroy()
     {
-        free(TranspositionTable);
+#if USE_TT_SNAPSHOT == 1
+        if (unmapTTSnapshot())
+            return;
+#endif
+        if (!TranspositionTable)
+            return;
+        freeHashTable(TranspositionTable, TT_SIZE * sizeof(TT_Entry), &TTInfo);
+#if USE_SHALLOW_TT == 1
+        freeHashTable(ShallowTT, SHALLOW_TT_SIZE * sizeof(uint64), &ShallowTTInfo);
+#endif
+#if USE_TRANSPOSITION_AT_LEAVES
+        freeHashTable(LeavesTT, LEAVES_TT_SIZE * sizeof(uint64), &LeavesTTInfo);
+#endif
+        TranspositionTable = NULL;
     }
 
 
@@ -1282,12 +1882,8 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         return pinned;
     }
 
-    // returns bitmask of squares in threat by enemy pieces
-    // the king shouldn't ever attempt to move to a threatened square
-    // TODO: maybe make this tempelated on color?
-    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 findAttackedSquares(uint64 emptySquares, uint64 enemyBishops, uint64 enemyRooks, 
-                                      uint64 enemyPawns, uint64 enemyKnights, uint64 enemyKing, 
-                                      uint64 myKing, uint8 enemyColor)
+    // squares attacked by enemy pawns, knights and king
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 findNonSlidingAttacks(uint64 enemyPawns, uint64 enemyKnights, uint64 enemyKing, uint8 enemyColor)
     {
         uint64 attacked = 0;
 
@@ -1310,19 +1906,32 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         attacked |= knightAttacks(enemyKnights);	
 #endif
         
-        // 3. bishop attacks
-        attacked |= multiBishopAttacks(enemyBishops, emptySquares | myKing); // squares behind king are also under threat (in the sense that king can't go there)
-
-        // 4. rook attacks
-        attacked |= multiRookAttacks(enemyRooks, emptySquares | myKing); // squares behind king are also under threat
-
-        // 5. King attacks
+        // 3. King attacks
 #if USE_KING_LUT == 1
         attacked |= sqKingAttacks(bitScan(enemyKing));	// a very tiny bit faster!
 #else
         attacked |= kingAttacks(enemyKing);
 #endif
-        
+
+        return attacked;
+    }
+
+    // returns bitmask of squares in threat by enemy pieces
+    // the king shouldn't ever attempt to move to a threatened square
+    // TODO: maybe make this tempelated on color?
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 findAttackedSquares(uint64 emptySquares, uint64 enemyBishops, uint64 enemyRooks, 
+                                      uint64 enemyPawns, uint64 enemyKnights, uint64 enemyKing, 
+                                      uint64 myKing, uint8 enemyColor)
+    {
+        // pawns, knights and king
+        uint64 attacked = findNonSlidingAttacks(enemyPawns, enemyKnights, enemyKing, enemyColor);
+
+        // bishop attacks
+        attacked |= multiBishopAttacks(enemyBishops, emptySquares | myKing); // squares behind king are also under threat (in the sense that king can't go there)
+
+        // rook attacks
+        attacked |= multiRookAttacks(enemyRooks, emptySquares | myKing); // squares behind king are also under threat
+
         // TODO: 
         // 1. figure out if we really need to mask off pieces on board
         //  - actually it seems better not to.. so that we can easily check if a capture move takes the king to check
@@ -1330,6 +1939,30 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         return attacked/*& (emptySquares)*/;
     }
 
+    // findPinnedPieces() and findAttackedSquares() together
+    // the avx2/avx-512 instances of the kogge-stone simd backend do the sliding pieces of both in one vectorized pass
+    CUDA_CALLABLE_MEMBER MY_INLINE static void findPinnedAndAttacked(uint64 myKing, uint64 myPieces, uint64 enemyBishops, uint64 enemyRooks,
+                                                                     uint64 allPieces, uint8 kingIndex, uint64 enemyPawns, uint64 enemyKnights,
+                                                                     uint64 enemyKing, uint8 enemyColor, uint64 *pinned, uint64 *attacked)
+    {
+#if USE_SIMD_KOGGE_STONE == 1 && !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2 && sliderBackend == SLIDER_KOGGE_STONE_SIMD)
+        {
+            uint64 sliderAttacks;
+            if (cpuTier >= CPU_TIER_AVX512)
+                koggeStoneAttacksAndPinsAvx512(enemyBishops, enemyRooks, myKing, allPieces, &sliderAttacks, pinned);
+            else
+                koggeStoneAttacksAndPinsAvx2  (enemyBishops, enemyRooks, myKing, allPieces, &sliderAttacks, pinned);
+
+            *attacked = sliderAttacks | findNonSlidingAttacks(enemyPawns, enemyKnights, enemyKing, enemyColor);
+            return;
+        }
+#endif
+        *pinned   = findPinnedPieces(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex);
+        *attacked = findAttackedSquares(~allPieces, enemyBishops, enemyRooks, enemyPawns, enemyKnights, enemyKing, 
+                                        myKing, enemyColor);
+    }
+
 
     // adds the given board to list and increments the move counter
     CUDA_CALLABLE_MEMBER MY_INLINE static void addMove(uint32 *nMoves, HexaBitBoardPosition **newPos, HexaBitBoardPosition *newBoard)
@@ -1994,11 +2627,9 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         uint64 myKing     = pos->kings & myPieces;
         uint8  kingIndex  = bitScan(myKing);
 
-        uint64 pinned     = findPinnedPieces(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex);
-
-        uint64 threatened = findAttackedSquares(~allPieces, enemyBishops, enemyRooks, allPawns & enemyPieces, 
-                                                pos->knights & enemyPieces, pos->kings & enemyPieces, 
-                                                myKing, !chance);
+        uint64 pinned, threatened;
+        findPinnedAndAttacked(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex, allPawns & enemyPieces,
+                              pos->knights & enemyPieces, pos->kings & enemyPieces, !chance, &pinned, &threatened);
 
 
 
@@ -2555,11 +3186,9 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         uint64 myKing     = pos->kings & myPieces;
         uint8  kingIndex  = bitScan(myKing);
 
-        uint64 pinned     = findPinnedPieces(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex);
-
-        uint64 threatened = findAttackedSquares(~allPieces, enemyBishops, enemyRooks, allPawns & enemyPieces, 
-                                                pos->knights & enemyPieces, pos->kings & enemyPieces, 
-                                                myKing, !chance);
+        uint64 pinned, threatened;
+        findPinnedAndAttacked(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex, allPawns & enemyPieces,
+                              pos->knights & enemyPieces, pos->kings & enemyPieces, !chance, &pinned, &threatened);
 
 
 
@@ -3433,11 +4062,9 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
         uint64 myKing     = pos->kings & myPieces;
         uint8  kingIndex  = bitScan(myKing);
 
-        uint64 pinned     = findPinnedPieces(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex);
-
-        uint64 threatened = findAttackedSquares(~allPieces, enemyBishops, enemyRooks, allPawns & enemyPieces, 
-                                                pos->knights & enemyPieces, pos->kings & enemyPieces, 
-                                                myKing, !chance);
+        uint64 pinned, threatened;
+        findPinnedAndAttacked(myKing, myPieces, enemyBishops, enemyRooks, allPieces, kingIndex, allPawns & enemyPieces,
+                              pos->knights & enemyPieces, pos->kings & enemyPieces, !chance, &pinned, &threatened);
 
 
         // king is in check: call special generate function to generate only the moves that take king out of check
@@ -3710,137 +4337,491 @@ CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiKnightAttacks(uint64 knights)
     }
 };
 
-#if DEBUG_PRINT_TIME_BREAKUP == 1
-LARGE_INTEGER total_time_in_zob = {0};
-LARGE_INTEGER total_time_in_countMoves = {0};
-LARGE_INTEGER total_time_in_makeMove = {0};
+// instantiation used for everything outside the perft hot path (init, zobrist keys, finding magics, etc)
+#if USE_RUNTIME_CPU_DISPATCH == 1
+typedef MoveGeneratorBitboardT<CPU_TIER_GENERIC, DEFAULT_SLIDER_BACKEND> MoveGeneratorBitboard;
+#else
+typedef MoveGeneratorBitboardT<CPU_TIER_STATIC,  DEFAULT_SLIDER_BACKEND> MoveGeneratorBitboard;
 #endif
 
-// compute zobrist hash key for a given board position
-uint64 computeZobristKey(HexaBitBoardPosition *pos)
+// combined attacks of multiple sliders for the backends that work on one piece at a time
+template <int sliderBackend, int cpuTier>
+struct SliderAttacksLoop
 {
-#if DEBUG_PRINT_TIME_BREAKUP == 1
-    LARGE_INTEGER count1, count2;
-    QueryPerformanceCounter(&count1);    
-#endif
-
-    uint64 key = 0;
-    int chance = pos->chance;
-
-    // chance (side to move)
-    if (chance)
-        key ^= zob.chance;
-
-    // castling rights
-    if (pos->whiteCastle & CASTLE_FLAG_KING_SIDE)
-        key ^= zob.castlingRights[WHITE][0];
-    if (pos->whiteCastle & CASTLE_FLAG_QUEEN_SIDE)
-        key ^= zob.castlingRights[WHITE][1];
-
-    if (pos->blackCastle & CASTLE_FLAG_KING_SIDE)
-        key ^= zob.castlingRights[BLACK][0];
-    if (pos->blackCastle & CASTLE_FLAG_QUEEN_SIDE)
-        key ^= zob.castlingRights[BLACK][1];
-
-
-   
-    uint64 allPawns     = pos->pawns & RANKS2TO7;    // get rid of game state variables
-    uint64 allPieces    = pos->kings |  allPawns | pos->knights | pos->bishopQueens | pos->rookQueens;
-
-    // en-passent target
-    if (pos->enPassent)
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiBishopAttacks(uint64 bishops, uint64 pro)
     {
-        uint64 blackPieces  = allPieces & (~pos->whitePieces);
-        uint64 myPieces     = (chance == WHITE) ? pos->whitePieces : blackPieces;
-        uint64 myPawns      = allPawns & myPieces;
-
-        // only update the flag if en-passent is possible
-        uint64 enPassentCapturedPiece;
-        if (chance == BLACK)
-        {
-            enPassentCapturedPiece = BIT(pos->enPassent - 1) << (8 * 3);
-        }
-        else
+        uint64 attacks = 0;
+        while(bishops)
         {
-            enPassentCapturedPiece = BIT(pos->enPassent - 1) << (8 * 4);
+            uint64 bishop = BitOps<cpuTier>::getOne(bishops);
+            attacks |= SliderAttacks<sliderBackend, cpuTier>::bishopAttacks(bishop, pro);
+            bishops ^= bishop;
         }
-        uint64 epSources = (MoveGeneratorBitboard::eastOne(enPassentCapturedPiece) | 
-                            MoveGeneratorBitboard::westOne(enPassentCapturedPiece) )
-                            & myPawns;
 
-        if (epSources)
-        {
-            key ^= zob.enPassentTarget[pos->enPassent - 1];
-        }
+        return attacks;
     }
 
-    // piece-position
-    while(allPieces)
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiRookAttacks(uint64 rooks, uint64 pro)
     {
-        uint64 piece = MoveGeneratorBitboard::getOne(allPieces);
-        int square = bitScan(piece);
-        
-        int color = !(piece & pos->whitePieces);
-        if (piece & allPawns)
-        {
-            key ^= zob.pieces[color][ZOB_INDEX_PAWN][square];
-        }
-        else if (piece & pos->kings)
-        {
-            key ^= zob.pieces[color][ZOB_INDEX_KING][square];
-        }
-        else if (piece & pos->knights)
-        {
-            key ^= zob.pieces[color][ZOB_INDEX_KNIGHT][square];
-        }
-        else if (piece & pos->rookQueens & pos->bishopQueens)
-        {
-            key ^= zob.pieces[color][ZOB_INDEX_QUEEN][square];
-        }
-        else if (piece & pos->rookQueens)
-        {
-            key ^= zob.pieces[color][ZOB_INDEX_ROOK][square];
-        }
-        else if (piece & pos->bishopQueens)
+        uint64 attacks = 0;
+        while(rooks)
         {
-            key ^= zob.pieces[color][ZOB_INDEX_BISHOP][square];
+            uint64 rook = BitOps<cpuTier>::getOne(rooks);
+            attacks |= SliderAttacks<sliderBackend, cpuTier>::rookAttacks(rook, pro);
+            rooks ^= rook;
         }
 
-        allPieces ^= piece;
+        return attacks;
     }
+};
 
-
-#if DEBUG_PRINT_TIME_BREAKUP == 1
-    QueryPerformanceCounter(&count2);
-    total_time_in_zob.QuadPart += (count2.QuadPart - count1.QuadPart);    
+// fixed shift fancy magics (~800 KB tables)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_FANCY_MAGICS, cpuTier> : SliderAttacksLoop<SLIDER_FANCY_MAGICS, cpuTier>
+{
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(bishop);
+        uint64 occ = (~pro) & sqBishopAttacksMasked(square);
+#ifdef __CUDA_ARCH__
+        FancyMagicEntry magicEntry = sq_bishop_magics_fancy(square);
+        int index = (magicEntry.factor * occ) >> (64 - BISHOP_MAGIC_BITS);
+        return sq_fancy_magic_lookup_table(magicEntry.position + index);
+#else
+        // this version is slightly faster for CPUs.. why ?
+        uint64 magic  = HOT_TABLE(bishop_magics_fancy)[square].factor;
+        uint64 index = (magic * occ) >> (64 - BISHOP_MAGIC_BITS);
+        const uint64 *table = &HOT_TABLE(fancy_magic_lookup_table)[HOT_TABLE(bishop_magics_fancy)[square].position];
+        return table[index];
 #endif
+    }
 
-    return key;
-}
-
-// random generators and basic idea of finding magics taken from:
-// http://chessprogramming.wikispaces.com/Looking+for+Magics 
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(rook);
+        uint64 occ = (~pro) & sqRookAttacksMasked(square);
+#ifdef __CUDA_ARCH__
+        FancyMagicEntry magicEntry = sq_rook_magics_fancy(square);
+        int index = (magicEntry.factor * occ) >> (64 - ROOK_MAGIC_BITS);
+        return sq_fancy_magic_lookup_table(magicEntry.position + index);
+#else
+        // this version is slightly faster for CPUs.. why ?
+        uint64 magic  = HOT_TABLE(rook_magics_fancy)[square].factor;
+        uint64 index = (magic * occ) >> (64 - ROOK_MAGIC_BITS);
+        const uint64 *table = &HOT_TABLE(fancy_magic_lookup_table)[HOT_TABLE(rook_magics_fancy)[square].position];
+        return table[index];
+#endif
+    }
+};
 
-uint64 random_uint64() 
+// plain magics (2.3 MB tables)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_PLAIN_MAGICS, cpuTier> : SliderAttacksLoop<SLIDER_PLAIN_MAGICS, cpuTier>
 {
-      uint64 u1, u2, u3, u4;
-      u1 = (uint64)(rand()) & 0xFFFF; u2 = (uint64)(rand()) & 0xFFFF;
-      u3 = (uint64)(rand()) & 0xFFFF; u4 = (uint64)(rand()) & 0xFFFF;
-      return u1 | (u2 << 16) | (u3 << 32) | (u4 << 48);
-}
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(bishop);
+        uint64 occ = (~pro) & sqBishopAttacksMasked(square);
+        uint64 magic = sqBishopMagics(square);
+        uint64 index = (magic * occ) >> (64 - BISHOP_MAGIC_BITS);
+        return sqBishopMagicAttackTables(square, index);
+    }
 
-uint64 random_uint64_sparse() 
-{
-    return random_uint64() & random_uint64() & random_uint64();
-} 
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(rook);
+        uint64 occ = (~pro) & sqRookAttacksMasked(square);
+        uint64 magic = sqRookMagics(square);
+        uint64 index = (magic * occ) >> (64 - ROOK_MAGIC_BITS);
+        return sqRookMagicAttackTables(square, index);
+    }
+};
 
-// get i'th combo mask 
-uint64 getOccCombo(uint64 mask, uint64 i)
+// fancy magics with byte indices into tables of unique attack sets (~150 KB tables)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_BYTE_LOOKUP, cpuTier> : SliderAttacksLoop<SLIDER_BYTE_LOOKUP, cpuTier>
 {
-    uint64 op = 0;
-    while(i)
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
     {
-        int bit = i % 2;
+        uint8 square = BitOps<cpuTier>::bitScan(bishop);
+        uint64 occ = (~pro) & sqBishopAttacksMasked(square);
+#ifdef __CUDA_ARCH__
+        FancyMagicEntry magicEntry = sq_bishop_magics_fancy(square);
+        int index = (magicEntry.factor * occ) >> (64 - BISHOP_MAGIC_BITS);
+        int index2 = sq_fancy_byte_magic_lookup_table(magicEntry.position + index) + magicEntry.offset;
+        return sq_fancy_byte_BishopLookup(index2);
+#else
+        uint64 magic  = HOT_TABLE(bishop_magics_fancy)[square].factor;
+        uint64 index = (magic * occ) >> (64 - BISHOP_MAGIC_BITS);
+        const uint8 *table = &HOT_TABLE(fancy_byte_magic_lookup_table)[HOT_TABLE(bishop_magics_fancy)[square].position];
+        int index2 = table[index] + HOT_TABLE(bishop_magics_fancy)[square].offset;
+        return HOT_TABLE(fancy_byte_BishopLookup)[index2];
+#endif
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(rook);
+        uint64 occ = (~pro) & sqRookAttacksMasked(square);
+#ifdef __CUDA_ARCH__
+        FancyMagicEntry magicEntry = sq_rook_magics_fancy(square);
+        int index = (magicEntry.factor * occ) >> (64 - ROOK_MAGIC_BITS);
+        int index2 = sq_fancy_byte_magic_lookup_table(magicEntry.position + index) + magicEntry.offset;
+        return sq_fancy_byte_RookLookup(index2);
+#else
+        uint64 magic  = HOT_TABLE(rook_magics_fancy)[square].factor;
+        uint64 index = (magic * occ) >> (64 - ROOK_MAGIC_BITS);
+        const uint8 *table = &HOT_TABLE(fancy_byte_magic_lookup_table)[HOT_TABLE(rook_magics_fancy)[square].position];
+        int index2 = table[index] + HOT_TABLE(rook_magics_fancy)[square].offset;
+        return HOT_TABLE(fancy_byte_RookLookup)[index2];
+#endif
+    }
+};
+
+// kogge-stone fills: no tables at all, and handles multiple pieces at once
+template <int cpuTier>
+struct SliderAttacks<SLIDER_KOGGE_STONE, cpuTier>
+{
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+        return MoveGeneratorBitboard::bishopAttacksKoggeStone(bishop, pro);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        return MoveGeneratorBitboard::rookAttacksKoggeStone(rook, pro);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiBishopAttacks(uint64 bishops, uint64 pro)
+    {
+        return MoveGeneratorBitboard::bishopAttacksKoggeStone(bishops, pro);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 multiRookAttacks(uint64 rooks, uint64 pro)
+    {
+        return MoveGeneratorBitboard::rookAttacksKoggeStone(rooks, pro);
+    }
+};
+
+// BMI2 pext indexing dense per-square tables (~840 KB)
+// (the pext instance is only used on cpus with BMI2, falls back to fancy magics everywhere else)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_PEXT, cpuTier> : SliderAttacksLoop<SLIDER_PEXT, cpuTier>
+{
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+#if !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2)
+        {
+            uint8 square = BitOps<cpuTier>::bitScan(bishop);
+            return sqPextBishopAttacks(square, _pext_u64(~pro, sqBishopAttacksMasked(square)));
+        }
+#endif
+        return SliderAttacks<SLIDER_FANCY_MAGICS, cpuTier>::bishopAttacks(bishop, pro);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+#if !defined(__CUDA_ARCH__) && defined(_WIN64)
+        if (cpuTier >= CPU_TIER_AVX2)
+        {
+            uint8 square = BitOps<cpuTier>::bitScan(rook);
+            return sqPextRookAttacks(square, _pext_u64(~pro, sqRookAttacksMasked(square)));
+        }
+#endif
+        return SliderAttacks<SLIDER_FANCY_MAGICS, cpuTier>::rookAttacks(rook, pro);
+    }
+};
+
+// the kogge-stone simd backend: findPinnedAndAttacked and countMovesBatch take their simd paths, the attacks of
+// single pieces (moves of the sliders, scalar countMoves of the lanes the batch can't do) are the fancy magics'
+template <int cpuTier>
+struct SliderAttacks<SLIDER_KOGGE_STONE_SIMD, cpuTier> : SliderAttacks<SLIDER_FANCY_MAGICS, cpuTier>
+{
+};
+
+// hyperbola quintessence: o ^ (o - 2r) in both directions of a line, the reverse direction by byte swapping
+// only needs line masks and a 512 byte table for ranks (cpu only - no gpu copies of the tables)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_HYPERBOLA, cpuTier> : SliderAttacksLoop<SLIDER_HYPERBOLA, cpuTier>
+{
+    // attacks along a file, diagonal or anti-diagonal (mask excludes the square of the piece)
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 lineAttacks(uint64 piece, uint64 occ, uint64 mask)
+    {
+        uint64 forward = occ & mask;
+        uint64 reverse = flipVertical(forward);
+        forward -= piece;
+        reverse -= flipVertical(piece);
+        forward ^= flipVertical(reverse);
+        return forward & mask;
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rankAttacks(uint8 square, uint64 occ)
+    {
+        uint8 rankShift = square & 56;
+        uint8 innerOcc  = (occ >> (rankShift + 1)) & 63;
+        return ((uint64) HOT_TABLE(FirstRankAttacks)[innerOcc][square & 7]) << rankShift;
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(bishop);
+        return lineAttacks(bishop, ~pro, HOT_TABLE(DiagonalMaskEx)[square]) |
+               lineAttacks(bishop, ~pro, HOT_TABLE(AntiDiagonalMaskEx)[square]);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(rook);
+        return lineAttacks(rook, ~pro, HOT_TABLE(FileMaskEx)[square]) |
+               rankAttacks(square, ~pro);
+    }
+};
+
+// obstruction difference: for each line, (2 * nearest blocker above) - (nearest blocker below)
+// sets exactly the squares between the two blockers. 4 KB of masks (cpu only - no gpu copies of the tables)
+template <int cpuTier>
+struct SliderAttacks<SLIDER_OBSTRUCTION_DIFF, cpuTier> : SliderAttacksLoop<SLIDER_OBSTRUCTION_DIFF, cpuTier>
+{
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 lineAttacks(uint64 occ, const ObstructionLine &line)
+    {
+        uint64 lower = line.lower & occ;
+        uint64 upper = line.upper & occ;
+
+        // all squares from the nearest blocker below (or from a1 if none) upwards
+        uint64 fromLower = ALLSET << BitOps<cpuTier>::bitScanReverse(lower | 1);
+
+        // nearest blocker above (0 if none, also works when it's h8 as 2 * h8 overflows to 0)
+        uint64 upperBlocker = BitOps<cpuTier>::getOne(upper);
+
+        return (2 * upperBlocker + fromLower) & (line.lower | line.upper);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 bishopAttacks(uint64 bishop, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(bishop);
+        return lineAttacks(~pro, HOT_TABLE(ObstructionLines)[square][OD_DIAGONAL]) |
+               lineAttacks(~pro, HOT_TABLE(ObstructionLines)[square][OD_ANTI_DIAGONAL]);
+    }
+
+    CUDA_CALLABLE_MEMBER MY_INLINE static uint64 rookAttacks(uint64 rook, uint64 pro)
+    {
+        uint8 square = BitOps<cpuTier>::bitScan(rook);
+        return lineAttacks(~pro, HOT_TABLE(ObstructionLines)[square][OD_FILE]) |
+               lineAttacks(~pro, HOT_TABLE(ObstructionLines)[square][OD_RANK]);
+    }
+};
+
+// select the sliding piece attack generator used by perft_bb (building its lookup tables if needed)
+// returns the backend actually selected
+int setSliderBackend(int backend)
+{
+    if (backend < 0 || backend >= NUM_SLIDER_BACKENDS)
+        backend = DEFAULT_SLIDER_BACKEND;
+
+    // pext and the simd passes are only compiled into the instances for cpus with BMI2/AVX2
+    if ((backend == SLIDER_PEXT || backend == SLIDER_KOGGE_STONE_SIMD) && g_cpuTier < CPU_TIER_AVX2)
+    {
+        printf("\n%s not available with the %s code path, using %s\n", sliderBackendNames[backend], cpuTierNames[g_cpuTier],
+               sliderBackendNames[SLIDER_FANCY_MAGICS]);
+        backend = SLIDER_FANCY_MAGICS;
+    }
+
+    if (backend == SLIDER_PLAIN_MAGICS)
+        MoveGeneratorBitboard::initPlainMagics();
+
+    if (backend == SLIDER_PEXT)
+        MoveGeneratorBitboard::initPextTables();
+
+    g_sliderBackend = backend;
+    return backend;
+}
+
+// -1 if there is no such backend
+int findSliderBackend(const char *name)
+{
+    for (int i = 0; i < NUM_SLIDER_BACKENDS; i++)
+        if (strcmp(name, sliderBackendOptions[i]) == 0)
+            return i;
+    return -1;
+}
+
+// calls (and returns the value of) the given function template instantiated for the
+// cpu tier and slider backend in use
+// (instances below CPU_TIER_AVX2 never use pext or the simd passes so those cases are just the fancy magics instance)
+#define CALL_FOR_SLIDER_BACKEND(tier, func, ...)                                                                \
+    switch (g_sliderBackend)                                                                                    \
+    {                                                                                                           \
+        case SLIDER_PEXT:           return func<tier, (tier >= CPU_TIER_AVX2) ? SLIDER_PEXT                    \
+                                                                              : SLIDER_FANCY_MAGICS>(__VA_ARGS__); \
+        case SLIDER_PLAIN_MAGICS:   return func<tier, SLIDER_PLAIN_MAGICS>(__VA_ARGS__);                        \
+        case SLIDER_BYTE_LOOKUP:    return func<tier, SLIDER_BYTE_LOOKUP> (__VA_ARGS__);                        \
+        case SLIDER_KOGGE_STONE:    return func<tier, SLIDER_KOGGE_STONE> (__VA_ARGS__);                        \
+        case SLIDER_HYPERBOLA:      return func<tier, SLIDER_HYPERBOLA>   (__VA_ARGS__);                        \
+        case SLIDER_OBSTRUCTION_DIFF: return func<tier, SLIDER_OBSTRUCTION_DIFF>(__VA_ARGS__);                  \
+        case SLIDER_KOGGE_STONE_SIMD: return func<tier, (tier >= CPU_TIER_AVX2) ? SLIDER_KOGGE_STONE_SIMD          \
+                                                                                : SLIDER_FANCY_MAGICS>(__VA_ARGS__); \
+        default:                    return func<tier, SLIDER_FANCY_MAGICS>(__VA_ARGS__);                        \
+    }
+
+#if USE_RUNTIME_CPU_DISPATCH == 1
+#define CALL_FOR_GENERATOR(func, ...)                                                                           \
+    switch (g_cpuTier)                                                                                          \
+    {                                                                                                           \
+        case CPU_TIER_AVX512:   CALL_FOR_SLIDER_BACKEND(CPU_TIER_AVX512,  func, __VA_ARGS__)                    \
+        case CPU_TIER_AVX2:     CALL_FOR_SLIDER_BACKEND(CPU_TIER_AVX2,    func, __VA_ARGS__)                    \
+        case CPU_TIER_POPCNT:   CALL_FOR_SLIDER_BACKEND(CPU_TIER_POPCNT,  func, __VA_ARGS__)                    \
+        default:                CALL_FOR_SLIDER_BACKEND(CPU_TIER_GENERIC, func, __VA_ARGS__)                    \
+    }
+#else
+#define CALL_FOR_GENERATOR(func, ...) CALL_FOR_SLIDER_BACKEND(CPU_TIER_STATIC, func, __VA_ARGS__)
+#endif
+
+#if DEBUG_PRINT_TIME_BREAKUP == 1
+LARGE_INTEGER total_time_in_zob = {0};
+LARGE_INTEGER total_time_in_countMoves = {0};
+LARGE_INTEGER total_time_in_makeMove = {0};
+#endif
+
+// compute zobrist hash key for a given board position (using the given set of random numbers)
+uint64 computeZobristKey(HexaBitBoardPosition *pos, const ZobristRandoms &keys)
+{
+#if DEBUG_PRINT_TIME_BREAKUP == 1
+    LARGE_INTEGER count1, count2;
+    QueryPerformanceCounter(&count1);    
+#endif
+
+    uint64 key = 0;
+    int chance = pos->chance;
+
+    // chance (side to move)
+    if (chance)
+        key ^= keys.chance;
+
+    // castling rights
+    if (pos->whiteCastle & CASTLE_FLAG_KING_SIDE)
+        key ^= keys.castlingRights[WHITE][0];
+    if (pos->whiteCastle & CASTLE_FLAG_QUEEN_SIDE)
+        key ^= keys.castlingRights[WHITE][1];
+
+    if (pos->blackCastle & CASTLE_FLAG_KING_SIDE)
+        key ^= keys.castlingRights[BLACK][0];
+    if (pos->blackCastle & CASTLE_FLAG_QUEEN_SIDE)
+        key ^= keys.castlingRights[BLACK][1];
+
+
+   
+    uint64 allPawns     = pos->pawns & RANKS2TO7;    // get rid of game state variables
+    uint64 allPieces    = pos->kings |  allPawns | pos->knights | pos->bishopQueens | pos->rookQueens;
+
+    // en-passent target
+    if (pos->enPassent)
+    {
+        uint64 blackPieces  = allPieces & (~pos->whitePieces);
+        uint64 myPieces     = (chance == WHITE) ? pos->whitePieces : blackPieces;
+        uint64 myPawns      = allPawns & myPieces;
+
+        // only update the flag if en-passent is possible
+        uint64 enPassentCapturedPiece;
+        if (chance == BLACK)
+        {
+            enPassentCapturedPiece = BIT(pos->enPassent - 1) << (8 * 3);
+        }
+        else
+        {
+            enPassentCapturedPiece = BIT(pos->enPassent - 1) << (8 * 4);
+        }
+        uint64 epSources = (MoveGeneratorBitboard::eastOne(enPassentCapturedPiece) | 
+                            MoveGeneratorBitboard::westOne(enPassentCapturedPiece) )
+                            & myPawns;
+
+        if (epSources)
+        {
+            key ^= keys.enPassentTarget[pos->enPassent - 1];
+        }
+    }
+
+    // piece-position
+    while(allPieces)
+    {
+        uint64 piece = MoveGeneratorBitboard::getOne(allPieces);
+        int square = bitScan(piece);
+        
+        int color = !(piece & pos->whitePieces);
+        if (piece & allPawns)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_PAWN][square];
+        }
+        else if (piece & pos->kings)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_KING][square];
+        }
+        else if (piece & pos->knights)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_KNIGHT][square];
+        }
+        else if (piece & pos->rookQueens & pos->bishopQueens)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_QUEEN][square];
+        }
+        else if (piece & pos->rookQueens)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_ROOK][square];
+        }
+        else if (piece & pos->bishopQueens)
+        {
+            key ^= keys.pieces[color][ZOB_INDEX_BISHOP][square];
+        }
+
+        allPieces ^= piece;
+    }
+
+
+#if DEBUG_PRINT_TIME_BREAKUP == 1
+    QueryPerformanceCounter(&count2);
+    total_time_in_keys.QuadPart += (count2.QuadPart - count1.QuadPart);    
+#endif
+
+    return key;
+}
+
+uint64 computeZobristKey(HexaBitBoardPosition *pos)
+{
+    return computeZobristKey(pos, zob);
+}
+
+// 128 bit key: for results that are kept for good (see ResultStore.h), where 64 bit collisions are too likely
+HashKey128b computeZobristKey128(HexaBitBoardPosition *pos)
+{
+    HashKey128b key;
+    key.lowPart  = computeZobristKey(pos, zob);
+    key.highPart = computeZobristKey(pos, zob2);
+    return key;
+}
+
+// random generators and basic idea of finding magics taken from:
+// http://chessprogramming.wikispaces.com/Looking+for+Magics 
+
+uint64 random_uint64() 
+{
+      uint64 u1, u2, u3, u4;
+      u1 = (uint64)(rand()) & 0xFFFF; u2 = (uint64)(rand()) & 0xFFFF;
+      u3 = (uint64)(rand()) & 0xFFFF; u4 = (uint64)(rand()) & 0xFFFF;
+      return u1 | (u2 << 16) | (u3 << 32) | (u4 << 48);
+}
+
+uint64 random_uint64_sparse() 
+{
+    return random_uint64() & random_uint64() & random_uint64();
+} 
+
+// get i'th combo mask 
+uint64 getOccCombo(uint64 mask, uint64 i)
+{
+    uint64 op = 0;
+    while(i)
+    {
+        int bit = i % 2;
         uint64 opBit = MoveGeneratorBitboard::getOne(mask);
         mask &= ~opBit;
         op |= opBit * bit;
@@ -3960,6 +4941,101 @@ uint64 findBishopMagicForSquare(int square, uint64 magicAttackTable[], uint64 pr
     return findMagicCommon(occCombos, attacks, magicAttackTable, numCombos, BISHOP_MAGIC_BITS, preCalculatedMagic, uniqueAttackTable, byteIndices, numUniqueAttacks);
 }
 
+#if USE_GENERATED_TABLES != 1
+// write out the lookup tables built by init() as AttackTables.h
+// (plain magics are searched for here, with generated tables only their attack tables are filled at run time)
+static void writeTable64(FILE *fp, const char *declaration, const uint64 *table, int rows, int cols)
+{
+    fprintf(fp, "%s =\n{\n", declaration);
+    for (int r = 0; r < rows; r++)
+    {
+        fprintf(fp, rows > 1 ? "    {" : "   ");
+        for (int c = 0; c < cols; c++)
+        {
+            uint64 x = table[r * cols + c];
+            if (c % 4 == 0 && c)
+                fprintf(fp, rows > 1 ? "\n     " : "\n   ");
+            if (x)
+                fprintf(fp, " 0x%016llxull,", x);
+            else
+                fprintf(fp, " 0,");
+        }
+        fprintf(fp, rows > 1 ? " },\n" : "\n");
+    }
+    fprintf(fp, "};\n\n");
+}
+
+static void writeTable8(FILE *fp, const char *declaration, const uint8 *table, int rows, int cols)
+{
+    fprintf(fp, "%s =\n{\n", declaration);
+    for (int r = 0; r < rows; r++)
+    {
+        fprintf(fp, rows > 1 ? "    {" : "   ");
+        for (int c = 0; c < cols; c++)
+        {
+            if (c % 32 == 0 && c)
+                fprintf(fp, rows > 1 ? "\n     " : "\n   ");
+            fprintf(fp, " %d,", table[r * cols + c]);
+        }
+        fprintf(fp, rows > 1 ? " },\n" : "\n");
+    }
+    fprintf(fp, "};\n\n");
+}
+
+void writeAttackTables(const char *fileName)
+{
+    MoveGeneratorBitboard::initPlainMagics();
+    MoveGeneratorBitboard::initPextTables();
+
+    FILE *fp = fopen(fileName, "w");
+    if (!fp)
+    {
+        printf("\ncan't open %s for writing\n", fileName);
+        return;
+    }
+
+    fprintf(fp, "// lookup tables used by the bitboard move generator (see USE_GENERATED_TABLES in MoveGeneratorBitboard.h)\n");
+    fprintf(fp, "// generated by writeAttackTables() - don't edit\n\n");
+
+    writeTable64(fp, "static const uint64 Between[64][64]",         &Between[0][0], 64, 64);
+    writeTable64(fp, "static const uint64 Line[64][64]",            &Line[0][0],    64, 64);
+    writeTable64(fp, "static const uint64 RookAttacks[64]",         RookAttacks,    1, 64);
+    writeTable64(fp, "static const uint64 BishopAttacks[64]",       BishopAttacks,  1, 64);
+    writeTable64(fp, "static const uint64 QueenAttacks[64]",        QueenAttacks,   1, 64);
+    writeTable64(fp, "static const uint64 KingAttacks[64]",         KingAttacks,    1, 64);
+    writeTable64(fp, "static const uint64 KnightAttacks[64]",       KnightAttacks,  1, 64);
+    writeTable64(fp, "static const uint64 RookAttacksMasked[64]",   RookAttacksMasked,   1, 64);
+    writeTable64(fp, "static const uint64 BishopAttacksMasked[64]", BishopAttacksMasked, 1, 64);
+
+    writeTable64(fp, "const uint64 rookMagics[64]",   rookMagics,   1, 64);
+    writeTable64(fp, "const uint64 bishopMagics[64]", bishopMagics, 1, 64);
+
+    writeTable64(fp, "const unsigned long long fancy_magic_lookup_table[97264]", fancy_magic_lookup_table, 1, 97264);
+    writeTable8 (fp, "const unsigned char fancy_byte_magic_lookup_table[97264]", fancy_byte_magic_lookup_table, 1, 97264);
+    writeTable64(fp, "const unsigned long long fancy_byte_RookLookup[4900]",     fancy_byte_RookLookup,   1, 4900);
+    writeTable64(fp, "const unsigned long long fancy_byte_BishopLookup[1428]",   fancy_byte_BishopLookup, 1, 1428);
+
+    writeTable64(fp, "const uint64 pextAttackTable[PEXT_ROOK_TABLE_SIZE + PEXT_BISHOP_TABLE_SIZE]", pextAttackTable, 1, PEXT_ROOK_TABLE_SIZE + PEXT_BISHOP_TABLE_SIZE);
+
+    fprintf(fp, "const uint32 pextRookOffset[64] =\n{");
+    for (int square = A1; square <= H8; square++)
+        fprintf(fp, "%s %6d,", square % 8 ? "" : "\n   ", pextRookOffset[square]);
+    fprintf(fp, "\n};\n\nconst uint32 pextBishopOffset[64] =\n{");
+    for (int square = A1; square <= H8; square++)
+        fprintf(fp, "%s %6d,", square % 8 ? "" : "\n   ", pextBishopOffset[square]);
+    fprintf(fp, "\n};\n\n");
+
+    writeTable64(fp, "static const uint64 FileMaskEx[64]",          FileMaskEx,         1, 64);
+    writeTable64(fp, "static const uint64 DiagonalMaskEx[64]",      DiagonalMaskEx,     1, 64);
+    writeTable64(fp, "static const uint64 AntiDiagonalMaskEx[64]",  AntiDiagonalMaskEx, 1, 64);
+    writeTable8 (fp, "static const uint8 FirstRankAttacks[64][8]",  &FirstRankAttacks[0][0], 64, 8);
+    writeTable64(fp, "static const ObstructionLine ObstructionLines[64][4]", (const uint64 *) ObstructionLines, 64, 8);
+
+    fclose(fp);
+    printf("\nlookup tables written to %s\n", fileName);
+}
+#endif
+
 // only for testing
 #if 0
 uint64 rookMagicAttackTables[64][1 << ROOK_MAGIC_BITS];
@@ -3999,24 +5075,15 @@ void findMagics()
 }
 #endif
 
-#if DEBUG_PRINT_UNIQUE_COUNTMOVES == 1
-uint64 globalCountMovesCounter = 0;
-#endif
-
-#if PRINT_HASH_STATS == 1
-uint64  numProbes[MAX_GAME_LENGTH];
-uint64  numHits[MAX_GAME_LENGTH];
-uint64  numStores[MAX_GAME_LENGTH];
-#endif
+#include "PerftVariants.h"
+#include "PerftStats.h"
 
 
 // perft helper functions
+template <int cpuTier, int sliderBackend>
 uint32 countMoves(HexaBitBoardPosition *pos)
 {
     uint32 nMoves;
-#if DEBUG_PRINT_UNIQUE_COUNTMOVES == 1
-    globalCountMovesCounter++;
-#endif
 
 #if DEBUG_PRINT_TIME_BREAKUP == 1
     LARGE_INTEGER count1, count2;
@@ -4028,14 +5095,14 @@ uint32 countMoves(HexaBitBoardPosition *pos)
 #if USE_TEMPLATE_CHANCE_OPT == 1
     if (chance == BLACK)
     {
-        nMoves = MoveGeneratorBitboard::countMoves<BLACK>(pos);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template countMoves<BLACK>(pos);
     }
     else
     {
-        nMoves = MoveGeneratorBitboard::countMoves<WHITE>(pos);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template countMoves<WHITE>(pos);
     }
 #else
-    nMoves = MoveGeneratorBitboard::countMoves(pos, chance);
+    nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::countMoves(pos, chance);
 #endif
 
 #if DEBUG_PRINT_TIME_BREAKUP == 1
@@ -4046,6 +5113,7 @@ uint32 countMoves(HexaBitBoardPosition *pos)
     return nMoves;
 }
 
+template <int cpuTier, int sliderBackend>
 uint32 generateBoards(HexaBitBoardPosition *pos, HexaBitBoardPosition *newPositions)
 {
     uint32 nMoves;
@@ -4053,19 +5121,20 @@ uint32 generateBoards(HexaBitBoardPosition *pos, HexaBitBoardPosition *newPositi
 #if USE_TEMPLATE_CHANCE_OPT == 1
     if (chance == BLACK)
     {
-        nMoves = MoveGeneratorBitboard::generateBoards<BLACK>(pos, newPositions);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template generateBoards<BLACK>(pos, newPositions);
     }
     else
     {
-        nMoves = MoveGeneratorBitboard::generateBoards<WHITE>(pos, newPositions);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template generateBoards<WHITE>(pos, newPositions);
     }
 #else
-    nMoves = MoveGeneratorBitboard::generateBoards(pos, newPositions, chance);
+    nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::generateBoards(pos, newPositions, chance);
 #endif
    
     return nMoves;
 }
 
+template <int cpuTier, int sliderBackend>
 uint32 generateMoves(HexaBitBoardPosition *pos, CMove *genMoves)
 {
     uint32 nMoves;
@@ -4073,19 +5142,20 @@ uint32 generateMoves(HexaBitBoardPosition *pos, CMove *genMoves)
 #if USE_TEMPLATE_CHANCE_OPT == 1
     if (chance == BLACK)
     {
-        nMoves = MoveGeneratorBitboard::generateMoves<BLACK>(pos, genMoves);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template generateMoves<BLACK>(pos, genMoves);
     }
     else
     {
-        nMoves = MoveGeneratorBitboard::generateMoves<WHITE>(pos, genMoves);
+        nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::template generateMoves<WHITE>(pos, genMoves);
     }
 #else
-    nMoves = MoveGeneratorBitboard::generateMoves(pos, genMoves, chance);
+    nMoves = MoveGeneratorBitboardT<cpuTier, sliderBackend>::generateMoves(pos, genMoves, chance);
 #endif
    
     return nMoves;
 }
 
+template <int cpuTier, int sliderBackend>
 MY_INLINE void makeMove(HexaBitBoardPosition *newPos, uint64 &hash, CMove move, uint8 chance)
 {
 
@@ -4097,14 +5167,14 @@ MY_INLINE void makeMove(HexaBitBoardPosition *newPos, uint64 &hash, CMove move,
 #if USE_TEMPLATE_CHANCE_OPT == 1
     if (chance == BLACK)
     {
-        MoveGeneratorBitboard::makeMove<BLACK>(newPos, hash, move);
+        MoveGeneratorBitboardT<cpuTier, sliderBackend>::template makeMove<BLACK>(newPos, hash, move);
     }
     else
     {
-        MoveGeneratorBitboard::makeMove<WHITE>(newPos, hash, move);
+        MoveGeneratorBitboardT<cpuTier, sliderBackend>::template makeMove<WHITE>(newPos, hash, move);
     }
 #else
-        MoveGeneratorBitboard::makeMove(newPos, hash, move, chance);
+        MoveGeneratorBitboardT<cpuTier, sliderBackend>::makeMove(newPos, hash, move, chance);
 #endif
 
 #if DEBUG_PRINT_TIME_BREAKUP == 1
@@ -4113,97 +5183,185 @@ MY_INLINE void makeMove(HexaBitBoardPosition *newPos, uint64 &hash, CMove move,
 #endif
 }
 
+// versions of the above for callers outside the perft hot path (dispatch on every call)
+uint32 countMoves(HexaBitBoardPosition *pos)
+{
+    CALL_FOR_GENERATOR(countMoves, pos);
+}
+
+uint32 generateBoards(HexaBitBoardPosition *pos, HexaBitBoardPosition *newPositions)
+{
+    CALL_FOR_GENERATOR(generateBoards, pos, newPositions);
+}
+
+uint32 generateMoves(HexaBitBoardPosition *pos, CMove *genMoves)
+{
+    CALL_FOR_GENERATOR(generateMoves, pos, genMoves);
+}
+
+void makeMove(HexaBitBoardPosition *newPos, uint64 &hash, CMove move, uint8 chance)
+{
+    CALL_FOR_GENERATOR(makeMove, newPos, hash, move, chance);
+}
+
+#include "CountMovesBatch.h"
+
 
 
 // transposition table helper functions
 
-#if USE_TRANSPOSITION_TABLE == 1
 // look up the transposition table for an entry
+// (entries in the parts of the tables that haven't been faulted in yet read as empty, and stores to them are dropped)
 MY_INLINE TT_Entry lookupTT(uint64 hash)
 {
-    return TranspositionTable[hash & (TT_INDEX_BITS)];
+    uint64 index = hash & (TT_INDEX_BITS);
+    if (!hashTableReady(&TTInfo, index * sizeof(TT_Entry)))
+    {
+        TT_Entry empty;
+        memset(&empty, 0, sizeof(empty));
+        return empty;
+    }
+    return TranspositionTable[index];
 }
 
-// check if the given position is present in transposition table entry
-MY_INLINE bool searchTTEntry(TT_Entry &entry, uint64 hash, uint64 *perft)
+// ShallowTT and LeavesTT
+MY_INLINE uint64 lookupSmallTT(uint64 *table, HashTableInfo *info, uint64 index)
 {
-#if USE_DUAL_SLOT_TT == 1
-#if USE_LOCKLESS_HASH == 1
-    if (((entry.mostRecent.hashKey ^ entry.mostRecent.perftVal) & TT_HASH_BITS) == (hash & TT_HASH_BITS))
-#else
-    if ((entry.mostRecent.hashKey & TT_HASH_BITS) == (hash & TT_HASH_BITS))
-#endif
+    return hashTableReady(info, index * sizeof(uint64)) ? table[index] : 0;
+}
+
+MY_INLINE void storeSmallTT(uint64 *table, HashTableInfo *info, uint64 index, uint64 value)
+{
+    if (hashTableReady(info, index * sizeof(uint64)))
+        table[index] = value;
+}
+
+#if USE_TT_CACHE == 1
+template <class Stats = NoPerftStats>
+MY_INLINE bool probeTTCache(uint64 hash, uint32 depth, uint64 *perft)
+{
+    if (depth > TT_CACHE_MAX_DEPTH)
+        return false;
+
+    TTCacheEntry &entry = ttCache[hash & TT_CACHE_INDEX_BITS];
+    if (entry.hashKey == hash)
     {
-        *perft = entry.mostRecent.perftVal;
+        Stats::cacheHit(depth);
+        *perft = entry.perftVal;
         return true;
     }
-#if USE_LOCKLESS_HASH == 1
-    if (((entry.deepest.hashKey ^ entry.deepest.perftVal) & TT_HASH_BITS) == (hash & TT_HASH_BITS))
-#else
-    if ((entry.deepest.hashKey & TT_HASH_BITS) == (hash & TT_HASH_BITS))
+    return false;
+}
+
+// called for stores and for hits in the big tables
+MY_INLINE void storeTTCache(uint64 hash, uint32 depth, uint64 perft)
+{
+    if (depth > TT_CACHE_MAX_DEPTH)
+        return;
+
+    TTCacheEntry &entry = ttCache[hash & TT_CACHE_INDEX_BITS];
+    entry.hashKey  = hash;
+    entry.perftVal = perft;
+}
 #endif
-    {
-        *perft = entry.deepest.perftVal;
-        return true;
-    }
-#else
+
+// no of generations since the slot was written
+MY_INLINE int ttAge(HashEntryPerft &slot)
+{
+    return (uint8) (ttGeneration - slot.generation);
+}
+
+// how much we want to keep the slot: its depth, less for every generation it is old
+MY_INLINE int ttSlotValue(HashEntryPerft &slot)
+{
+    return slot.depth - TT_AGE_PENALTY * ttAge(slot);
+}
+
+template <class Stats = NoPerftStats>
+MY_INLINE bool searchTTSlot(HashEntryPerft &slot, uint64 hash, uint64 *perft)
+{
 #if USE_LOCKLESS_HASH == 1
-    if (((entry.hashKey ^ entry.perftVal) & TT_HASH_BITS) == (hash & TT_HASH_BITS))
+    if (((slot.hashKey ^ slot.perftVal) & TT_HASH_BITS) == (hash & TT_HASH_BITS))
 #else
-    if ((entry.hashKey & TT_HASH_BITS) == (hash & TT_HASH_BITS))
+    if ((slot.hashKey & TT_HASH_BITS) == (hash & TT_HASH_BITS))
 #endif
     {
-        *perft = entry.perftVal;
+        *perft = slot.perftVal;
+        Stats::hitAge(ttAge(slot));
         return true;
     }
+    return false;
+}
+
+// check if the given position is present in transposition table entry
+template <class Stats = NoPerftStats, class Variant = DefaultPerftVariant>
+MY_INLINE bool searchTTEntry(TT_Entry &entry, uint64 hash, uint64 *perft)
+{
+#if USE_DUAL_SLOT_TT == 1
+    // (single slot variant: only the deepest slot is used)
+    if (!Variant::dualSlot)
+        return searchTTSlot<Stats>(entry.deepest, hash, perft);
+    return searchTTSlot<Stats>(entry.mostRecent, hash, perft) || searchTTSlot<Stats>(entry.deepest, hash, perft);
+#else
+    return searchTTSlot<Stats>(entry, hash, perft);
 #endif
+}
 
-    return false;
+MY_INLINE void writeTTSlot(HashEntryPerft &slot, uint64 hash, int depth, uint64 count)
+{
+    slot.perftVal = count;
+    slot.hashKey = hash;
+#if USE_LOCKLESS_HASH == 1
+    // only the bits compared by searchTTSlot, depth and generation must stay readable
+    slot.hashKey ^= count & TT_HASH_BITS;
+#endif
+    slot.depth = depth;
+    slot.generation = ttGeneration;
 }
 
+template <class Variant = DefaultPerftVariant>
 MY_INLINE void storeTTEntry(TT_Entry &entry, uint64 hash, int depth, uint64 count, HexaBitBoardPosition *pos)
 {
+    if (!hashTableReady(&TTInfo, (hash & (TT_INDEX_BITS)) * sizeof(TT_Entry)))
+        return;
+
 #if USE_DUAL_SLOT_TT == 1
+    if (!Variant::dualSlot)
+    {
+        // same replacement as the single slot table
+        if (ttSlotValue(entry.deepest) <= depth)
+        {
+            writeTTSlot(entry.deepest, hash, depth, count);
+            TranspositionTable[hash & (TT_INDEX_BITS)] = entry;
+        }
+        return;
+    }
 
-    // add this pos to deepest slot if this is deeper than deepest, or if the deepest is empty (depth=0)
-    if (entry.deepest.depth <= depth)
+
+    // add this pos to deepest slot if this is deeper than deepest (after aging it), or if the deepest is empty (depth=0)
+    int deepestValue = ttSlotValue(entry.deepest);
+    if (deepestValue <= depth)
     {
         // avoid the entry to get overwritten if most recent slot is free (or is at lower depth)
-        if (entry.mostRecent.depth < entry.deepest.depth)
+        if (ttSlotValue(entry.mostRecent) < deepestValue)
         {
             entry.mostRecent = entry.deepest;
         }
 
-        entry.deepest.perftVal = count;
-        entry.deepest.hashKey = hash;
-        entry.deepest.depth = depth;
-#if USE_LOCKLESS_HASH == 1
-        entry.deepest.hashKey ^= count;
-#endif
+        writeTTSlot(entry.deepest, hash, depth, count);
         TranspositionTable[hash & (TT_INDEX_BITS)] = entry;
     }
     else
     {
         // otherwise add it to mostRecent slot
-        entry.mostRecent.perftVal = count;
-        entry.mostRecent.hashKey = hash;
-        entry.mostRecent.depth = depth;
-#if USE_LOCKLESS_HASH == 1
-        entry.mostRecent.hashKey ^= count;
-#endif
+        writeTTSlot(entry.mostRecent, hash, depth, count);
         TranspositionTable[hash & (TT_INDEX_BITS)] = entry;
     }
 #else
-    // only replace hash table entry if previously stored entry is at shallower depth
-    if (entry.depth <= depth)
+    // only replace hash table entry if previously stored entry is at shallower depth (or old enough)
+    if (ttSlotValue(entry) <= depth)
     {
-        entry.perftVal = count;
-        entry.hashKey = hash;
-        entry.depth = depth;
-#if USE_LOCKLESS_HASH == 1
-        entry.hashKey ^= count;
-#endif
-
+        writeTTSlot(entry, hash, depth, count);
 #if DEBUG_CATCH_HASH_COLLISIONS == 1
         entry.pos = *pos;
 #endif
@@ -4211,77 +5369,113 @@ MY_INLINE void storeTTEntry(TT_Entry &entry, uint64 hash, int depth, uint64 coun
     }
 #endif
 }
-#endif
 
-// perft counter function. Returns perft of the given board for given depth
-#if USE_MOVE_LIST == 1
-uint64 perft_bb(HexaBitBoardPosition *pos, uint64 origHash, uint32 depth)
+#include "FixedDepthPerft.h"
+
+// perft counter functions. Return perft of the given board for given depth
+// (Variant selects the move list or the generateBoards version and which of the optimizations they use, see
+// PerftVariants.h)
+
+// move list version: generateMoves and makeMove for every child
+template <int cpuTier, int sliderBackend, class Stats, class Variant>
+uint64 perft_bb_moves(HexaBitBoardPosition *pos, uint64 origHash, uint32 depth)
 {
     CMove genMoves[MAX_MOVES];
     uint32 nMoves = 0;
 
-#if USE_COUNT_ONLY_OPT == 1
-    if (depth == 1)
+    if (Variant::countOnly && depth == 1)
     {
 #if USE_TRANSPOSITION_AT_LEAVES == 1
 #if INCREMENTAL_ZOBRIST_UPDATE == 1
         // origHash is the zobrist hash key of the position
         uint64 hash = origHash;
 #else
-        hash = computeZobristKey(pos);
+        uint64 hash = Variant::tt ? computeZobristKey(pos) : 0;
 #endif
-        uint64 entry = LeavesTT[hash & (LEAVES_TT_INDEX_BITS)];
-        if ((entry & LEAVES_TT_HASH_BITS) == (hash & LEAVES_TT_HASH_BITS))
+        if (Variant::tt)
         {
-            return entry & LEAVES_TT_INDEX_BITS;
+#if USE_TT_CACHE == 1
+            uint64 cachedPerft;
+            if (probeTTCache<Stats>(hash, depth, &cachedPerft))
+                return cachedPerft;
+#endif
+            uint64 entry = lookupSmallTT(LeavesTT, &LeavesTTInfo, hash & (LEAVES_TT_INDEX_BITS));
+            if ((entry & LEAVES_TT_HASH_BITS) == (hash & LEAVES_TT_HASH_BITS))
+            {
+#if USE_TT_CACHE == 1
+                storeTTCache(hash, depth, entry & LEAVES_TT_INDEX_BITS);
+#endif
+                return entry & LEAVES_TT_INDEX_BITS;
+            }
         }
 #endif
 
-        nMoves = countMoves(pos);
+        uint64 countStart = Stats::startTimer();
+        nMoves = countMoves<cpuTier, sliderBackend>(pos);
+        Stats::countMovesTime(countStart);
+        Stats::countMoves(1);
 
 #if USE_TRANSPOSITION_AT_LEAVES == 1
-        LeavesTT[hash & (LEAVES_TT_INDEX_BITS)] = (hash  & LEAVES_TT_HASH_BITS)  |
-                                                  (nMoves & LEAVES_TT_INDEX_BITS) ;
+        if (Variant::tt)
+        {
+            storeSmallTT(LeavesTT, &LeavesTTInfo, hash & (LEAVES_TT_INDEX_BITS), (hash  & LEAVES_TT_HASH_BITS)  |
+                                                                                 (nMoves & LEAVES_TT_INDEX_BITS));
+#if USE_TT_CACHE == 1
+            storeTTCache(hash, depth, nMoves);
+#endif
+        }
 #endif
         return nMoves;
     }
-#endif
 
-    nMoves = generateMoves(pos, genMoves);
+    nMoves = generateMoves<cpuTier, sliderBackend>(pos, genMoves);
 
-#if USE_COUNT_ONLY_OPT == 0
-    if (depth == 1)
+    if (!Variant::countOnly && depth == 1)
         return nMoves;
-#endif
 
-#if USE_TRANSPOSITION_TABLE == 1
 #if INCREMENTAL_ZOBRIST_UPDATE == 1
     uint64 hash = origHash;
 #else
-    uint64 hash = computeZobristKey(pos);
+    uint64 hash = Variant::tt ? computeZobristKey(pos) : 0;
 #endif
     hash ^= zob.depth * depth;
     TT_Entry entry;
 
-    if (depth == 2)
+    if (Variant::tt)
     {
-        uint64 entry = ShallowTT[hash & (SHALLOW_TT_INDEX_BITS)];
-        if ((entry & SHALLOW_TT_HASH_BITS) == (hash & SHALLOW_TT_HASH_BITS))
+#if USE_TT_CACHE == 1
+        uint64 cachedPerft;
+        if (probeTTCache<Stats>(hash, depth, &cachedPerft))
+            return cachedPerft;
+#endif
+
+#if USE_SHALLOW_TT == 1
+        if (Variant::shallowTT && depth == 2)
         {
-            return entry & SHALLOW_TT_INDEX_BITS;
+            uint64 entry = lookupSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS));
+            if ((entry & SHALLOW_TT_HASH_BITS) == (hash & SHALLOW_TT_HASH_BITS))
+            {
+#if USE_TT_CACHE == 1
+                storeTTCache(hash, depth, entry & SHALLOW_TT_INDEX_BITS);
+#endif
+                return entry & SHALLOW_TT_INDEX_BITS;
+            }
         }
-    }
-    else
-    {
-        // look-up the transposition table for a match
-        entry = lookupTT(hash);
-        uint64 perftVal;
-        if (searchTTEntry(entry, hash, &perftVal))
+        else
+#endif
         {
-            return perftVal;
+            // look-up the transposition table for a match
+            entry = lookupTT(hash);
+            uint64 perftVal;
+            if (searchTTEntry<Stats, Variant>(entry, hash, &perftVal))
+            {
+#if USE_TT_CACHE == 1
+                storeTTCache(hash, depth, perftVal);
+#endif
+                return perftVal;
+            }
         }
     }
-#endif
 
 
     uint64 count = 0;
@@ -4294,31 +5488,38 @@ uint64 perft_bb(HexaBitBoardPosition *pos, uint64 origHash, uint32 depth)
 
         uint64 newHash = origHash;
         // newHash passed by reference!
-        makeMove(&newPos, newHash, genMoves[i], chance);
+        makeMove<cpuTier, sliderBackend>(&newPos, newHash, genMoves[i], chance);
 
-        uint64 childPerft = perft_bb(&newPos, newHash, depth - 1);
+        uint64 childPerft = perft_bb_moves<cpuTier, sliderBackend, Stats, Variant>(&newPos, newHash, depth - 1);
         count += childPerft;
     }
 
-#if USE_TRANSPOSITION_TABLE == 1
-    if (depth == 2)
+    if (Variant::tt)
     {
-        ShallowTT[hash & (SHALLOW_TT_INDEX_BITS)] = (hash  & SHALLOW_TT_HASH_BITS)  |
-                                                    (count & SHALLOW_TT_INDEX_BITS) ;
-    }
-    else
-    {
-        storeTTEntry(entry, hash, depth, count, pos);
-    }
+#if USE_TT_CACHE == 1
+        storeTTCache(hash, depth, count);
 #endif
+#if USE_SHALLOW_TT == 1
+        if (Variant::shallowTT && depth == 2)
+        {
+            storeSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS), (hash  & SHALLOW_TT_HASH_BITS)  |
+                                                                                    (count & SHALLOW_TT_INDEX_BITS));
+        }
+        else
+#endif
+        {
+            storeTTEntry<Variant>(entry, hash, depth, count, pos);
+        }
+    }
 
     return count;
 
 }
-#else
 
+// generateBoards version
 // this version doesn't use incremental hash
-uint64 perft_bb(HexaBitBoardPosition *pos, uint64 /*hash*/, uint32 depth)
+template <int cpuTier, int sliderBackend, class Stats, class Variant>
+uint64 perft_bb_boards(HexaBitBoardPosition *pos, uint64 /*hash*/, uint32 depth)
 {
     HexaBitBoardPosition newPositions[MAX_MOVES];
 
@@ -4331,101 +5532,201 @@ uint64 perft_bb(HexaBitBoardPosition *pos, uint64 /*hash*/, uint32 depth)
 
     uint32 nMoves = 0;
 
-#if USE_COUNT_ONLY_OPT == 1
-    if (depth == 1)
+#if DEBUG_PRINT_MOVES != 1
+    // (the hash table variants probe at these depths)
+    if (Variant::fixedDepth && Variant::countOnly && !Variant::tt && depth >= 2 && depth <= FIXED_DEPTH_PLIES)
+        return perftFixedDepth<cpuTier, sliderBackend, Stats>(pos, depth);
+#endif
+
+    if (Variant::countOnly && depth == 1)
     {
 #if USE_TRANSPOSITION_AT_LEAVES == 1
-        uint64 hash = computeZobristKey(pos);
-        hash ^= zob.depth * depth;
+        uint64 hash = 0;
         TT_Entry entry;
-
-        // look-up the transposition table for a match
-        entry = lookupTT(hash);
-        uint64 perftVal;
-        if (searchTTEntry(entry, hash, &perftVal))
+#if USE_ADAPTIVE_TT == 1
+        TTDepthPolicy *policy = &ttDepthPolicy[depth];
+        uint64 sampleStart = Variant::tt ? ttSampleStart(policy) : 0;
+        bool useTT = Variant::tt && !policy->disabled;
+        if (useTT)
+#else
+        if (Variant::tt)
+#endif
         {
-            return perftVal;
+            uint64 zobristStart = Stats::startTimer();
+            hash = computeZobristKey(pos);
+            hash ^= zob.depth * depth;
+            Stats::zobristTime(zobristStart);
+
+            bool found = false;
+            uint64 perftVal = 0;
+#if USE_TT_CACHE == 1
+            found = probeTTCache<Stats>(hash, depth, &perftVal);
+            if (!found)
+#endif
+            {
+                // look-up the transposition table for a match
+                entry = lookupTT(hash);
+                found = searchTTEntry<Stats, Variant>(entry, hash, &perftVal);
+#if USE_TT_CACHE == 1
+                if (found)
+                    storeTTCache(hash, depth, perftVal);
+#endif
+            }
+#if USE_ADAPTIVE_TT == 1
+            ttSampleProbe(policy, sampleStart, found);
+#endif
+            if (found)
+                return perftVal;
         }
+#if USE_ADAPTIVE_TT == 1
+        uint64 subtreeStart = sampleStart ? __rdtsc() : 0;
+#endif
 #endif
 
-    nMoves = countMoves(pos);
+    uint64 countStart = Stats::startTimer();
+    nMoves = countMoves<cpuTier, sliderBackend>(pos);
+    Stats::countMovesTime(countStart);
+    Stats::countMoves(1);
 
 #if USE_TRANSPOSITION_AT_LEAVES == 1
-    storeTTEntry(entry, hash, depth, nMoves, pos);
+#if USE_ADAPTIVE_TT == 1
+    ttSampleSubtree(policy, subtreeStart);
+    if (useTT)
+#else
+    if (Variant::tt)
+#endif
+    {
+        storeTTEntry<Variant>(entry, hash, depth, nMoves, pos);
+#if USE_TT_CACHE == 1
+        storeTTCache(hash, depth, nMoves);
+#endif
+    }
 #endif
         return nMoves;
     }
+
+#if USE_RESULT_STORE == 1
+    HashKey128b resultKey;
+    bool useResultStore = depth >= RESULT_STORE_MIN_DEPTH && resultStoreOpen();
+    if (useResultStore)
+    {
+        resultKey = computeZobristKey128(pos);
+        uint64 storedCount;
+        if (lookupResult(resultKey, depth, &storedCount))
+            return storedCount;
+    }
 #endif
 
-    nMoves = generateBoards(pos, newPositions);
+    PHASE_BEGIN(depth)
+
+    nMoves = generateBoards<cpuTier, sliderBackend>(pos, newPositions);
 
-#if USE_COUNT_ONLY_OPT == 0
-    if (depth == 1)
+    if (!Variant::countOnly && depth == 1)
         return nMoves;
-#endif
+
+    countNodeStats<cpuTier, sliderBackend>(pos, depth, nMoves);
+    PHASE_MARK(PHASE_GENERATE)
 
 
-#if USE_TRANSPOSITION_TABLE == 1
     TT_Entry entry;
-    uint64   hash = computeZobristKey(pos);
-    hash ^= zob.depth * depth;
-#if PRINT_HASH_STATS == 1
-    numProbes[depth]++;
+    uint64   hash = 0;
+#if USE_ADAPTIVE_TT == 1
+    TTDepthPolicy *policy = &ttDepthPolicy[depth];
+    uint64 sampleStart = Variant::tt ? ttSampleStart(policy) : 0;
+    bool useTT = Variant::tt && !policy->disabled;
+    if (useTT)
+#else
+    if (Variant::tt)
 #endif
-#if USE_SHALLOW_TT == 1
-    if (depth == 2)
     {
-        uint64 entry = ShallowTT[hash & (SHALLOW_TT_INDEX_BITS)];
-        if ((entry & SHALLOW_TT_HASH_BITS) == (hash & SHALLOW_TT_HASH_BITS))
+        uint64 zobristStart = Stats::startTimer();
+        hash = computeZobristKey(pos);
+        hash ^= zob.depth * depth;
+        Stats::zobristTime(zobristStart);
+        Stats::probe(depth);
+        bool found = false;
+        uint64 perftVal = 0;
+#if USE_TT_CACHE == 1
+        found = probeTTCache<Stats>(hash, depth, &perftVal);
+#endif
+#if USE_SHALLOW_TT == 1
+        if (!found && Variant::shallowTT && depth == 2)
         {
-#if PRINT_HASH_STATS == 1
-            numHits[2]++;
+            uint64 entry = lookupSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS));
+            if ((entry & SHALLOW_TT_HASH_BITS) == (hash & SHALLOW_TT_HASH_BITS))
+            {
+                found = true;
+                perftVal = entry & SHALLOW_TT_INDEX_BITS;
+#if USE_TT_CACHE == 1
+                storeTTCache(hash, depth, perftVal);
 #endif
-            return entry & SHALLOW_TT_INDEX_BITS;
+                Stats::hit(2);
+            }
         }
-    }
-    else
+        else
 #endif
-    {
-        // look-up the transposition table for a match
-        entry = lookupTT(hash);
-        uint64 perftVal = 0;
-        if (searchTTEntry(entry, hash, &perftVal))
+        if (!found)
         {
-#if PRINT_HASH_STATS == 1
-            numHits[depth]++;
+            // look-up the transposition table for a match
+            entry = lookupTT(hash);
+            if (searchTTEntry<Stats, Variant>(entry, hash, &perftVal))
+            {
+                found = true;
+#if USE_TT_CACHE == 1
+                storeTTCache(hash, depth, perftVal);
 #endif
+                Stats::hit(depth);
 #if DEBUG_CATCH_HASH_COLLISIONS == 1
-            if (entry.depth != depth)
-            {
-                printf("got collision due to depth!\n");
-                BoardPosition testBoard;
-                Utils::boardHexBBTo088(&testBoard, pos);
-                Utils::dispBoard(&testBoard);
-            }
-            if (memcmp(&entry.pos, pos, sizeof(entry.pos)))
-            {
-                printf("got collision!\n");
-                BoardPosition testBoard;
+                if (entry.depth != depth)
+                {
+                    printf("got collision due to depth!\n");
+                    BoardPosition testBoard;
+                    Utils::boardHexBBTo088(&testBoard, pos);
+                    Utils::dispBoard(&testBoard);
+                }
+                if (memcmp(&entry.pos, pos, sizeof(entry.pos)))
+                {
+                    printf("got collision!\n");
+                    BoardPosition testBoard;
 
-                Utils::boardHexBBTo088(&testBoard, &entry.pos);
-                Utils::dispBoard(&testBoard);
+                    Utils::boardHexBBTo088(&testBoard, &entry.pos);
+                    Utils::dispBoard(&testBoard);
 
-                Utils::boardHexBBTo088(&testBoard, pos);
-                Utils::dispBoard(&testBoard);
+                    Utils::boardHexBBTo088(&testBoard, pos);
+                    Utils::dispBoard(&testBoard);
+                }
+#endif
             }
+        }
+        PHASE_MARK(PHASE_PROBE)
+        countProbeStats(depth, found);
+#if USE_ADAPTIVE_TT == 1
+        ttSampleProbe(policy, sampleStart, found);
 #endif
+        if (found)
             return perftVal;
-        }
     }
+#if USE_ADAPTIVE_TT == 1
+    uint64 subtreeStart = sampleStart ? __rdtsc() : 0;
 #endif
 
 
     uint64 count = 0;
 
+#if USE_TRANSPOSITION_AT_LEAVES != 1 && DEBUG_PRINT_MOVES != 1
+    // leaf-parent: count the moves of all the children together
+    if (Variant::countOnly && depth == 2)
+    {
+        uint64 countStart = Stats::startTimer();
+        count = countMovesBatch<cpuTier, sliderBackend>(newPositions, nMoves);
+        Stats::countMovesTime(countStart);
+        Stats::countMoves(nMoves);
+    }
+    else
+#endif
     for (uint32 i=0; i < nMoves; i++)
     {
-        uint64 childPerft = perft_bb(&newPositions[i], 0, depth - 1);
+        uint64 childPerft = perft_bb_boards<cpuTier, sliderBackend, Stats, Variant>(&newPositions[i], 0, depth - 1);
 #if DEBUG_PRINT_MOVES == 1
         if (depth == DEBUG_PRINT_DEPTH)
             printf("%llu\n", childPerft);
@@ -4433,6 +5734,18 @@ uint64 perft_bb(HexaBitBoardPosition *pos, uint64 /*hash*/, uint32 depth)
         count += childPerft;
     }
 
+#if PROFILE_PHASES == 1
+    // (the children of other nodes are sampled at their own depth)
+    if (depth == 2)
+    {
+        PHASE_MARK(PHASE_COUNT)
+    }
+    else
+    {
+        PHASE_SKIP()
+    }
+#endif
+
     /*
     if (perftVal && perftVal != count)
     {
@@ -4440,24 +5753,110 @@ uint64 perft_bb(HexaBitBoardPosition *pos, uint64 /*hash*/, uint32 depth)
     }
     */
 
-#if USE_TRANSPOSITION_TABLE == 1
-#if PRINT_HASH_STATS == 1
-    numStores[depth]++;
+#if USE_ADAPTIVE_TT == 1
+    ttSampleSubtree(policy, subtreeStart);
+    if (useTT)
+#else
+    if (Variant::tt)
 #endif
-#if USE_SHALLOW_TT == 1
-    if (depth == 2)
     {
-        //printf("%08X%08X\n", HI(hash), LO(hash));
+        Stats::store(depth);
+#if USE_TT_CACHE == 1
+        storeTTCache(hash, depth, count);
+#endif
+#if USE_SHALLOW_TT == 1
+        if (Variant::shallowTT && depth == 2)
+        {
+            //printf("%08X%08X\n", HI(hash), LO(hash));
 
-        ShallowTT[hash & (SHALLOW_TT_INDEX_BITS)] = (hash  & SHALLOW_TT_HASH_BITS)  |
-                                                    (count & SHALLOW_TT_INDEX_BITS) ;
+            storeSmallTT(ShallowTT, &ShallowTTInfo, hash & (SHALLOW_TT_INDEX_BITS), (hash  & SHALLOW_TT_HASH_BITS)  |
+                                                                                    (count & SHALLOW_TT_INDEX_BITS));
+        }
+        else
+#endif
+        {
+            storeTTEntry<Variant>(entry, hash, depth, count, pos);
+        }
+        PHASE_MARK(PHASE_STORE)
     }
+
+#if USE_RESULT_STORE == 1
+    if (useResultStore)
+        storeResult(resultKey, depth, count);
+#endif
+    return count;
+}
+
+template <int cpuTier, int sliderBackend, class Stats = NoPerftStats, class Variant = DefaultPerftVariant>
+MY_INLINE uint64 perft_bb(HexaBitBoardPosition *pos, uint64 hash, uint32 depth)
+{
+    if (Variant::moveList)
+        return perft_bb_moves<cpuTier, sliderBackend, Stats, Variant>(pos, hash, depth);
     else
+        return perft_bb_boards<cpuTier, sliderBackend, Stats, Variant>(pos, hash, depth);
+}
+
+// the variant selected with setPerftVariant() (the ones that aren't in this build are never selected)
+template <int cpuTier, int sliderBackend, class Stats>
+uint64 perft_bb_variant(HexaBitBoardPosition *pos, uint64 hash, uint32 depth)
+{
+    switch (g_perftVariant)
+    {
+        case PERFT_VARIANT_BOARDS:          return perft_bb<cpuTier, sliderBackend, Stats, BoardsVariant>(pos, hash, depth);
+        case PERFT_VARIANT_BOARDS_GENERIC:  return perft_bb<cpuTier, sliderBackend, Stats, BoardsGenericVariant>(pos, hash, depth);
+        case PERFT_VARIANT_BOARDS_NO_COUNT: return perft_bb<cpuTier, sliderBackend, Stats, BoardsNoCountVariant>(pos, hash, depth);
+        case PERFT_VARIANT_MOVE_LIST:       return perft_bb<cpuTier, sliderBackend, Stats, MoveListVariant>(pos, hash, depth);
+        case PERFT_VARIANT_TT:              return perft_bb<cpuTier, sliderBackend, Stats, TTVariant>(pos, hash, depth);
+        case PERFT_VARIANT_MOVE_LIST_TT:    return perft_bb<cpuTier, sliderBackend, Stats, MoveListTTVariant>(pos, hash, depth);
+#if USE_DUAL_SLOT_TT == 1
+        case PERFT_VARIANT_TT_SINGLE_SLOT:  return perft_bb<cpuTier, sliderBackend, Stats, TTSingleSlotVariant>(pos, hash, depth);
+#endif
+#if USE_SHALLOW_TT == 1
+        case PERFT_VARIANT_TT_NO_SHALLOW:   return perft_bb<cpuTier, sliderBackend, Stats, TTNoShallowVariant>(pos, hash, depth);
 #endif
+        default:                            return perft_bb<cpuTier, sliderBackend, Stats>(pos, hash, depth);
+    }
+}
+
+// (for CALL_FOR_GENERATOR)
+template <int cpuTier, int sliderBackend>
+uint64 perft_bb_selected(HexaBitBoardPosition *pos, uint64 hash, uint32 depth)
+{
+    return perft_bb_variant<cpuTier, sliderBackend, NoPerftStats>(pos, hash, depth);
+}
+
+template <int cpuTier, int sliderBackend>
+uint64 perft_bb_counting(HexaBitBoardPosition *pos, uint64 hash, uint32 depth)
+{
+    return perft_bb_variant<cpuTier, sliderBackend, CountingPerftStats>(pos, hash, depth);
+}
+
+// select the engine variant run by the perft entry points, returns the variant actually selected
+int setPerftVariant(int variant)
+{
+    if (!perftVariantAvailable(variant))
+        variant = PERFT_VARIANT_DEFAULT;
+    if (perftVariantFlags(variant) & VARIANT_FLAG_TT)
+        allocTranspositionTables();
+    g_perftVariant = variant;
+    return variant;
+}
+
+// perft entry point: runs the perft_bb instantiation for the cpu we are running on (and the selected slider backend
+// and engine variant) with the instrumented instance if g_perftStats is set
+uint64 perft_bb(HexaBitBoardPosition *pos, uint64 hash, uint32 depth)
+{
+    if (g_perftStats)
     {
-        storeTTEntry(entry, hash, depth, count, pos);
+        CALL_FOR_GENERATOR(perft_bb_counting, pos, hash, depth);
     }
-#endif
-    return count;
+    if (g_perftVariant != PERFT_VARIANT_DEFAULT)
+    {
+        CALL_FOR_GENERATOR(perft_bb_selected, pos, hash, depth);
+    }
+    CALL_FOR_GENERATOR(perft_bb, pos, hash, depth);
 }
-#endif
\ No newline at end of file
+
+#if USE_TRANSPOSITION_TABLE == 1 && USE_INTERLEAVED_PERFT == 1
+#include "InterleavedPerft.h"
+#endif
@@ -0,0 +1,162 @@
+#ifndef NODE_STATS_H
+#define NODE_STATS_H
+
+// per thread, per depth counts of the nodes that perft actually searches
+// depth 2 nodes are the leaf-parents (one countMovesBatch call each), deeper ones are interior nodes. Nodes
+// answered by the hash tables aren't counted. For each depth: nodes, average branching factor, and how many of the
+// nodes had the side to move in check, in double check or with pinned pieces (i.e, took the slow paths of the
+// generator), and the hash table probes and hits at that depth. Collected by every perft instance (increments of
+// the thread's own counters, no atomics or timers) and printed after every perft. Other threads may read the
+// counters while a search runs (see CampaignStatus.h)
+//
+// included by PerftStats.h
+
+#include "ThreadRegistry.h"
+
+#define NODE_STATS_MAX_DEPTH    32      // deeper nodes aren't counted
+
+struct NodeStats
+{
+    uint64 nodes      [NODE_STATS_MAX_DEPTH];
+    uint64 children   [NODE_STATS_MAX_DEPTH];
+    uint64 inCheck    [NODE_STATS_MAX_DEPTH];
+    uint64 doubleCheck[NODE_STATS_MAX_DEPTH];
+    uint64 pinned     [NODE_STATS_MAX_DEPTH];
+    uint64 ttProbes   [NODE_STATS_MAX_DEPTH];
+    uint64 ttHits     [NODE_STATS_MAX_DEPTH];
+};
+
+// every thread that ever searched a node
+static ThreadRegistry<NodeStats> nodeStatsRegistry;
+
+static THREAD_LOCAL NodeStats *threadNodeStats = NULL;
+
+static NodeStats *getThreadNodeStats()
+{
+    if (threadNodeStats == NULL)
+        threadNodeStats = nodeStatsRegistry.add();
+    return threadNodeStats;
+}
+
+// after generating the nMoves children of pos
+template <int cpuTier, int sliderBackend>
+MY_INLINE void countNodeStats(HexaBitBoardPosition *pos, uint32 depth, uint32 nMoves)
+{
+    typedef MoveGeneratorBitboardT<cpuTier, sliderBackend> Gen;
+
+    NodeStats *stats = getThreadNodeStats();
+    if (!stats || depth >= NODE_STATS_MAX_DEPTH)
+        return;
+
+    uint8  chance       = pos->chance;
+    uint64 allPawns     = pos->pawns & RANKS2TO7;
+    uint64 allPieces    = pos->kings | allPawns | pos->knights | pos->bishopQueens | pos->rookQueens;
+    uint64 blackPieces  = allPieces & (~pos->whitePieces);
+    uint64 myPieces     = (chance == WHITE) ? pos->whitePieces : blackPieces;
+    uint64 enemyPieces  = (chance == WHITE) ? blackPieces      : pos->whitePieces;
+    uint64 enemyBishops = pos->bishopQueens & enemyPieces;
+    uint64 enemyRooks   = pos->rookQueens & enemyPieces;
+    uint64 king         = pos->kings & myPieces;
+
+    stats->nodes[depth]++;
+    stats->children[depth] += nMoves;
+
+    // same as in generateBoardsOutOfCheck
+    uint64 attackers = ((chance == WHITE) ? (Gen::northEastOne(king) | Gen::northWestOne(king)) :
+                                            (Gen::southEastOne(king) | Gen::southWestOne(king))) & allPawns & enemyPieces;
+    attackers |= Gen::knightAttacks(king) & pos->knights & enemyPieces;
+    attackers |= Gen::bishopAttacks(king, ~allPieces) & enemyBishops;
+    attackers |= Gen::rookAttacks(king, ~allPieces) & enemyRooks;
+
+    uint64 pinned = Gen::findPinnedPieces(king, myPieces, enemyBishops, enemyRooks, allPieces, BitOps<cpuTier>::bitScan(king));
+
+    stats->inCheck[depth]     += (attackers != 0);
+    stats->doubleCheck[depth] += ((attackers & (attackers - 1)) != 0);
+    stats->pinned[depth]      += (pinned != 0);
+}
+
+// a hash table probe (including the per thread cache)
+MY_INLINE void countProbeStats(uint32 depth, bool found)
+{
+    NodeStats *stats = getThreadNodeStats();
+    if (!stats || depth >= NODE_STATS_MAX_DEPTH)
+        return;
+    stats->ttProbes[depth]++;
+    stats->ttHits[depth] += found;
+}
+
+// call only when no search is running
+void resetNodeStats()
+{
+    for (int t = 0; t < nodeStatsRegistry.size(); t++)
+        if (nodeStatsRegistry.at(t))
+            memset(nodeStatsRegistry.at(t), 0, sizeof(NodeStats));
+}
+
+// per depth totals over all threads, then the nodes searched by each thread
+void printNodeStats()
+{
+    int numThreads = nodeStatsRegistry.size();
+    uint64 totalNodes = 0;
+    for (int t = 0; t < numThreads; t++)
+    {
+        NodeStats *stats = nodeStatsRegistry.at(t);
+        for (int depth = 0; stats && depth < NODE_STATS_MAX_DEPTH; depth++)
+            totalNodes += stats->nodes[depth];
+    }
+    if (totalNodes == 0)
+        return;
+
+    printf("\nsearched nodes per depth\n");
+    printf("depth         nodes   branching   in check   double check   pinned   hash hits\n");
+    uint64 interiorNodes = 0, leafParents = 0;
+    for (int depth = NODE_STATS_MAX_DEPTH - 1; depth >= 1; depth--)
+    {
+        uint64 nodes = 0, children = 0, inCheck = 0, doubleCheck = 0, pinned = 0, ttProbes = 0, ttHits = 0;
+        for (int t = 0; t < numThreads; t++)
+        {
+            NodeStats *stats = nodeStatsRegistry.at(t);
+            if (!stats)
+                continue;
+            nodes       += stats->nodes[depth];
+            children    += stats->children[depth];
+            inCheck     += stats->inCheck[depth];
+            doubleCheck += stats->doubleCheck[depth];
+            pinned      += stats->pinned[depth];
+            ttProbes    += stats->ttProbes[depth];
+            ttHits      += stats->ttHits[depth];
+        }
+        if (nodes == 0 && ttProbes == 0)
+            continue;
+
+        if (depth == 2)
+            leafParents += nodes;
+        else
+            interiorNodes += nodes;
+
+        // (all the probes at a depth can hit, nothing searched there)
+        double n = nodes ? (double) nodes : 1.0;
+        printf("%5d  %12llu  %10.2f  %8.2f%%  %12.2f%%  %6.2f%%", depth, nodes, children / n,
+               100.0 * inCheck / n, 100.0 * doubleCheck / n, 100.0 * pinned / n);
+        if (ttProbes)
+            printf("  %9.2f%%", 100.0 * ttHits / ttProbes);
+        printf("\n");
+    }
+    printf("interior nodes: %llu, leaf-parents (countMovesBatch calls): %llu\n", interiorNodes, leafParents);
+
+    if (numThreads > 1)
+    {
+        printf("nodes searched per thread:");
+        for (int t = 0; t < numThreads; t++)
+        {
+            NodeStats *stats = nodeStatsRegistry.at(t);
+            uint64 nodes = 0;
+            for (int depth = 0; stats && depth < NODE_STATS_MAX_DEPTH; depth++)
+                nodes += stats->nodes[depth];
+            printf(" %llu", nodes);
+        }
+        printf("\n");
+    }
+}
+
+#endif
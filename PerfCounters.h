@@ -0,0 +1,237 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// hardware performance counters of the calling thread (linux perf_event_open)
+// the counters are user mode only, so they work with the default perf_event_paranoid setting
+// on other OSes perfCountersOpen() just fails and callers print the timings alone
+
+#include "chess.h"
+#include <intrin.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+// the events we know about
+#define PERF_DTLB_LOADS         0
+#define PERF_DTLB_LOAD_MISSES   1
+#define PERF_L1D_LOADS          2
+#define PERF_L1D_LOAD_MISSES    3
+#define NUM_PERF_EVENTS         4
+
+static const char *perfEventNames[NUM_PERF_EVENTS] = { "dTLB loads", "dTLB load misses", "L1d loads", "L1d load misses" };
+
+struct PerfCounters
+{
+    int    fd[NUM_PERF_EVENTS];     // -1 for events the cpu/kernel doesn't support
+    uint64 value[NUM_PERF_EVENTS];  // filled by perfCountersStop
+};
+
+#ifdef __linux__
+static int openPerfEvent(uint32 type, uint64 config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+#define PERF_CACHE_EVENT(cache, result) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | ((result) << 16))
+#endif
+
+// returns false if none of the counters can be used
+bool perfCountersOpen(PerfCounters *pc)
+{
+    bool any = false;
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        pc->fd[i]    = -1;
+        pc->value[i] = 0;
+    }
+
+#ifdef __linux__
+    pc->fd[PERF_DTLB_LOADS]       = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+    pc->fd[PERF_DTLB_LOAD_MISSES] = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    pc->fd[PERF_L1D_LOADS]        = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,  PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+    pc->fd[PERF_L1D_LOAD_MISSES]  = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,  PERF_COUNT_HW_CACHE_RESULT_MISS));
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+        any |= pc->fd[i] >= 0;
+#endif
+
+    return any;
+}
+
+void perfCountersStart(PerfCounters *pc)
+{
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        if (pc->fd[i] >= 0)
+        {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void perfCountersStop(PerfCounters *pc)
+{
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        pc->value[i] = 0;
+        if (pc->fd[i] >= 0)
+        {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(pc->fd[i], &pc->value[i], sizeof(uint64)) != sizeof(uint64))
+                pc->value[i] = 0;
+        }
+    }
+#endif
+}
+
+void perfCountersClose(PerfCounters *pc)
+{
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_EVENTS; i++)
+    {
+        if (pc->fd[i] >= 0)
+            close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+#endif
+}
+
+// misses per access in percent, or -1 when either counter isn't available
+double perfMissRate(PerfCounters *pc, int accessEvent, int missEvent)
+{
+    if (pc->fd[accessEvent] < 0 || pc->fd[missEvent] < 0 || pc->value[accessEvent] == 0)
+        return -1;
+    return 100.0 * pc->value[missEvent] / pc->value[accessEvent];
+}
+
+// a group of counters read together with a single read() (for sampling parts of the search, see PhaseProfile.h)
+// counts are running totals since perfGroupOpen, callers take differences
+// without perf_event_open (or a pmu, e.g. in most VMs) only PERF_GROUP_CYCLES is filled, from rdtsc
+#define PERF_GROUP_CYCLES           0
+#define PERF_GROUP_INSTRUCTIONS     1
+#define PERF_GROUP_BRANCH_MISSES    2
+#define PERF_GROUP_L1D_MISSES       3
+#define PERF_GROUP_LLC_MISSES       4
+#define PERF_GROUP_DTLB_MISSES      5
+#define NUM_PERF_GROUP_EVENTS       6
+
+static const char *perfGroupEventNames[NUM_PERF_GROUP_EVENTS] = { "cycles", "instructions", "branch misses", "L1d misses",
+                                                                  "LLC misses", "dTLB misses" };
+
+struct PerfCounterGroup
+{
+    int  leader;                            // -1 when using rdtsc
+    int  fd[NUM_PERF_GROUP_EVENTS];
+    int  slot[NUM_PERF_GROUP_EVENTS];       // position of the event in what read() returns, -1 if not counted
+    int  numOpen;
+};
+
+#ifdef __linux__
+static int openPerfGroupEvent(uint32 type, uint64 config, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = (groupFd == -1);  // the leader enables the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+// returns false if only rdtsc cycles are available
+bool perfGroupOpen(PerfCounterGroup *group)
+{
+    group->leader  = -1;
+    group->numOpen = 0;
+    for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+    {
+        group->fd[i]   = -1;
+        group->slot[i] = -1;
+    }
+
+#ifdef __linux__
+    uint32 types[NUM_PERF_GROUP_EVENTS]   = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                              PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE };
+    uint64 configs[NUM_PERF_GROUP_EVENTS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+                                              PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,  PERF_COUNT_HW_CACHE_RESULT_MISS),
+                                              PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_LL,   PERF_COUNT_HW_CACHE_RESULT_MISS),
+                                              PERF_CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS) };
+
+    group->leader = openPerfGroupEvent(types[0], configs[0], -1);
+    if (group->leader < 0)
+    {
+        group->leader = -1;
+        return false;
+    }
+    group->fd[0]   = group->leader;
+    group->slot[0] = group->numOpen++;
+
+    // events the cpu doesn't have are left out
+    for (int i = 1; i < NUM_PERF_GROUP_EVENTS; i++)
+    {
+        group->fd[i] = openPerfGroupEvent(types[i], configs[i], group->leader);
+        if (group->fd[i] >= 0)
+            group->slot[i] = group->numOpen++;
+    }
+
+    ioctl(group->leader, PERF_EVENT_IOC_RESET, 0);
+    ioctl(group->leader, PERF_EVENT_IOC_ENABLE, 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// current totals (0 for events not counted)
+inline void perfGroupRead(PerfCounterGroup *group, uint64 *values)
+{
+#ifdef __linux__
+    if (group->leader >= 0)
+    {
+        uint64 buffer[1 + NUM_PERF_GROUP_EVENTS];   // nr, then the values
+        if (read(group->leader, buffer, sizeof(buffer)) > 0)
+        {
+            for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+                values[i] = group->slot[i] >= 0 ? buffer[1 + group->slot[i]] : 0;
+            return;
+        }
+    }
+#endif
+    memset(values, 0, NUM_PERF_GROUP_EVENTS * sizeof(uint64));
+    values[PERF_GROUP_CYCLES] = __rdtsc();
+}
+
+void perfGroupClose(PerfCounterGroup *group)
+{
+#ifdef __linux__
+    for (int i = NUM_PERF_GROUP_EVENTS - 1; i >= 0; i--)
+        if (group->fd[i] >= 0)
+            close(group->fd[i]);
+#endif
+    group->leader = -1;
+    for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+        group->fd[i] = -1;
+}
+
+#endif
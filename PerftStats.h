@@ -0,0 +1,144 @@
+#ifndef PERFT_STATS_H
+#define PERFT_STATS_H
+
+// instrumentation of the perft drivers as a template policy: the Stats parameter of perft_bb, perft_interleaved and
+// the hash table helpers they call
+//  NoPerftStats       - the default, every hook is empty and compiles to nothing
+//  CountingPerftStats - hash probes/hits/stores and per thread cache hits per depth, hits by entry age, countMoves
+//                       calls, and time spent computing hash keys and counting moves
+// (the searched node counts of NodeStats.h are not part of it: every instance collects them)
+// the non template entry points pick the instance at runtime (g_perftStats: "perft -stats [-variant <name>] ..."), so
+// that any build and engine variant can be diagnosed. PRINT_HASH_STATS and DEBUG_PRINT_UNIQUE_COUNTMOVES just turn it
+// on by default
+// (every thread counts into its own block, the blocks are summed when printed: times are summed over the threads too)
+//
+// included by MoveGeneratorBitboard.h
+
+#include "ThreadRegistry.h"
+#include "NodeStats.h"
+
+#define NUM_HIT_AGES 3      // TranspositionTable hits by how many generations old the entry was: current, previous, older
+
+struct PerftStatsCounters
+{
+    uint64 probes[MAX_GAME_LENGTH];
+    uint64 hits[MAX_GAME_LENGTH];
+    uint64 stores[MAX_GAME_LENGTH];
+
+    // probes answered by the per thread cache (i.e, DRAM accesses saved)
+    uint64 cacheHits[MAX_GAME_LENGTH];
+
+    uint64 hitsByAge[NUM_HIT_AGES];
+    uint64 countMovesCalls;
+
+    // QueryPerformanceCounter ticks
+    uint64 zobristTime;
+    uint64 countMovesTime;
+};
+
+// every thread that ever ran an instrumented search
+static ThreadRegistry<PerftStatsCounters> perftStatsRegistry;
+
+static THREAD_LOCAL PerftStatsCounters *threadPerftStats = NULL;
+
+// (threads beyond MAX_REGISTRY_THREADS count into a block that is never printed)
+static PerftStatsCounters droppedPerftStats;
+
+MY_INLINE static PerftStatsCounters *getThreadPerftStats()
+{
+    if (threadPerftStats == NULL)
+    {
+        threadPerftStats = perftStatsRegistry.add();
+        if (threadPerftStats == NULL)
+            threadPerftStats = &droppedPerftStats;
+    }
+    return threadPerftStats;
+}
+
+static bool g_perftStats = (PRINT_HASH_STATS == 1 || DEBUG_PRINT_UNIQUE_COUNTMOVES == 1);
+
+struct NoPerftStats
+{
+    MY_INLINE static void   probe(uint32 depth)                     {}
+    MY_INLINE static void   hit(uint32 depth)                       {}
+    MY_INLINE static void   cacheHit(uint32 depth)                  {}
+    MY_INLINE static void   store(uint32 depth)                     {}
+    MY_INLINE static void   hitAge(int age)                         {}
+    MY_INLINE static void   countMoves(uint32 calls)                {}
+    MY_INLINE static uint64 startTimer()                            { return 0; }
+    MY_INLINE static void   zobristTime(uint64 start)               {}
+    MY_INLINE static void   countMovesTime(uint64 start)            {}
+};
+
+struct CountingPerftStats
+{
+    MY_INLINE static void   probe(uint32 depth)                     { getThreadPerftStats()->probes[depth]++; }
+    MY_INLINE static void   hit(uint32 depth)                       { getThreadPerftStats()->hits[depth]++; }
+    MY_INLINE static void   cacheHit(uint32 depth)                  { getThreadPerftStats()->cacheHits[depth]++; }
+    MY_INLINE static void   store(uint32 depth)                     { getThreadPerftStats()->stores[depth]++; }
+    MY_INLINE static void   hitAge(int age)                         { getThreadPerftStats()->hitsByAge[age < NUM_HIT_AGES ? age : NUM_HIT_AGES - 1]++; }
+    MY_INLINE static void   countMoves(uint32 calls)                { getThreadPerftStats()->countMovesCalls += calls; }
+
+    MY_INLINE static uint64 startTimer()
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return now.QuadPart;
+    }
+    MY_INLINE static void   zobristTime(uint64 start)               { getThreadPerftStats()->zobristTime += startTimer() - start; }
+    MY_INLINE static void   countMovesTime(uint64 start)            { getThreadPerftStats()->countMovesTime += startTimer() - start; }
+};
+
+// call only when no search is running
+void resetPerftStats()
+{
+    for (int t = 0; t < perftStatsRegistry.size(); t++)
+        if (perftStatsRegistry.at(t))
+            memset(perftStatsRegistry.at(t), 0, sizeof(PerftStatsCounters));
+}
+
+// the blocks of all the threads added up (all the fields are uint64 counters)
+static void sumPerftStats(PerftStatsCounters *total)
+{
+    memset(total, 0, sizeof(PerftStatsCounters));
+    for (int t = 0; t < perftStatsRegistry.size(); t++)
+    {
+        uint64 *counters = (uint64 *) perftStatsRegistry.at(t);
+        for (int i = 0; counters && i < (int) (sizeof(PerftStatsCounters) / sizeof(uint64)); i++)
+            ((uint64 *) total)[i] += counters[i];
+    }
+}
+
+void printPerftStats(int maxDepth)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    PerftStatsCounters perftStats;
+    sumPerftStats(&perftStats);
+
+    printf("No of calls to countMoves: %llu\n", perftStats.countMovesCalls);
+    printf("zobrist computation time: %g seconds, countMoves: %g seconds\n",
+           (double) perftStats.zobristTime / frequency.QuadPart, (double) perftStats.countMovesTime / frequency.QuadPart);
+
+    // (the selected variant, not the build switch: the hash table variants are in every build)
+    if (!(perftVariantFlags(g_perftVariant) & VARIANT_FLAG_TT))
+        return;
+
+    printf("\nHash stats per depth\n");
+    printf("depth   hash probes      hash hits    hash stores     cache hits\n");
+    for (int i = 2; i <= maxDepth; i++)
+        printf("%5d   %11llu    %11llu    %11llu    %11llu\n", i, perftStats.probes[i], perftStats.hits[i], perftStats.stores[i],
+               perftStats.cacheHits[i]);
+    printf("transposition table hits by generation - current: %llu, previous: %llu, older: %llu\n",
+           perftStats.hitsByAge[0], perftStats.hitsByAge[1], perftStats.hitsByAge[2]);
+#if USE_ADAPTIVE_TT == 1
+    printf("hash tables in use at depths:");
+    for (int i = 1; i <= maxDepth; i++)
+        if (!ttDepthPolicy[i].disabled)
+            printf(" %d", i);
+    printf("\n");
+#endif
+}
+
+#endif
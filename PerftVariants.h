@@ -0,0 +1,134 @@
+#ifndef PERFT_VARIANTS_H
+#define PERFT_VARIANTS_H
+
+// engine variants as a template policy: the Variant parameter of perft_bb and the hash table helpers it calls
+// replaces the USE_MOVE_LIST, USE_COUNT_ONLY_OPT, USE_FIXED_DEPTH_PERFT, USE_TRANSPOSITION_TABLE, USE_DUAL_SLOT_TT and
+// USE_SHALLOW_TT tests in the perft_bb bodies, so that a few useful combinations are compiled into the same binary
+// and can be A/B'ed on the same box and workload ("perft -variant <name> ...", "perft variants [repeats]")
+// all of them are compiled into every build: the hash table variants too, their tables are allocated when one of them
+// is selected if USE_TRANSPOSITION_TABLE isn't set (see setPerftVariant). The layout of the tables is still fixed
+// by USE_DUAL_SLOT_TT and USE_SHALLOW_TT, and tt-single-slot only emulates a single slot table on the dual slot
+// entries (same memory, just the deepest slot)
+// the default variant is the one the switches select, and the only one the interleaved driver runs (the others go
+// through perft_bb, with or without -stats)
+//
+// included by MoveGeneratorBitboard.h
+
+#define VARIANT_FLAG_MOVE_LIST      1
+#define VARIANT_FLAG_COUNT_ONLY     2
+#define VARIANT_FLAG_FIXED_DEPTH    4
+#define VARIANT_FLAG_TT             8
+#define VARIANT_FLAG_DUAL_SLOT      16
+#define VARIANT_FLAG_SHALLOW_TT     32
+
+template <bool useMoveList, bool useCountOnly, bool useFixedDepth, bool useTT, bool useDualSlot, bool useShallowTT>
+struct PerftVariant
+{
+    static const bool moveList   = useMoveList;     // generateMoves + makeMove instead of generateBoards
+    static const bool countOnly  = useCountOnly;    // countMoves at depth 1 (countMovesBatch at depth 2)
+    static const bool fixedDepth = useFixedDepth;   // FixedDepthPerft for the last plies (generateBoards, no hash)
+    static const bool tt         = useTT;           // probe/store the hash tables
+    static const bool dualSlot   = useDualSlot;     // most recent + deepest slot (USE_DUAL_SLOT_TT layout only)
+    static const bool shallowTT  = useShallowTT;    // depth 2 nodes in ShallowTT instead of TranspositionTable
+
+    // all of the above as bits (for the result store header)
+    static const uint32 flags = (useMoveList   ? VARIANT_FLAG_MOVE_LIST   : 0) | (useCountOnly ? VARIANT_FLAG_COUNT_ONLY : 0) |
+                                (useFixedDepth ? VARIANT_FLAG_FIXED_DEPTH : 0) | (useTT        ? VARIANT_FLAG_TT         : 0) |
+                                (useDualSlot   ? VARIANT_FLAG_DUAL_SLOT   : 0) | (useShallowTT ? VARIANT_FLAG_SHALLOW_TT : 0);
+};
+
+#if USE_TRANSPOSITION_TABLE == 1 && USE_DUAL_SLOT_TT == 1
+#define DEFAULT_VARIANT_DUAL_SLOT   true
+#else
+#define DEFAULT_VARIANT_DUAL_SLOT   false
+#endif
+
+#if USE_TRANSPOSITION_TABLE == 1 && USE_SHALLOW_TT == 1
+#define DEFAULT_VARIANT_SHALLOW_TT  true
+#else
+#define DEFAULT_VARIANT_SHALLOW_TT  false
+#endif
+
+// the layout of the tables, for the variants that use them
+#define TT_VARIANT_DUAL_SLOT        (USE_DUAL_SLOT_TT == 1)
+#define TT_VARIANT_SHALLOW_TT       (USE_SHALLOW_TT == 1)
+
+typedef PerftVariant<USE_MOVE_LIST == 1, USE_COUNT_ONLY_OPT == 1, USE_FIXED_DEPTH_PERFT == 1, USE_TRANSPOSITION_TABLE == 1,
+                     DEFAULT_VARIANT_DUAL_SLOT, DEFAULT_VARIANT_SHALLOW_TT>            DefaultPerftVariant;
+
+//                    move list  count only  fixed depth  hash   dual slot              shallow tt
+typedef PerftVariant<false,     true,       true,        false, false,                 false>                 BoardsVariant;
+typedef PerftVariant<false,     true,       false,       false, false,                 false>                 BoardsGenericVariant;
+typedef PerftVariant<false,     false,      false,       false, false,                 false>                 BoardsNoCountVariant;
+typedef PerftVariant<true,      true,       false,       false, false,                 false>                 MoveListVariant;
+typedef PerftVariant<false,     true,       false,       true,  TT_VARIANT_DUAL_SLOT,  TT_VARIANT_SHALLOW_TT> TTVariant;
+typedef PerftVariant<false,     true,       false,       true,  false,                 TT_VARIANT_SHALLOW_TT> TTSingleSlotVariant;
+typedef PerftVariant<false,     true,       false,       true,  TT_VARIANT_DUAL_SLOT,  false>                 TTNoShallowVariant;
+typedef PerftVariant<true,      true,       false,       true,  TT_VARIANT_DUAL_SLOT,  TT_VARIANT_SHALLOW_TT> MoveListTTVariant;
+
+// runtime selection (g_perftVariant)
+#define PERFT_VARIANT_DEFAULT           0
+#define PERFT_VARIANT_BOARDS            1
+#define PERFT_VARIANT_BOARDS_GENERIC    2       // without FixedDepthPerft
+#define PERFT_VARIANT_BOARDS_NO_COUNT   3
+#define PERFT_VARIANT_MOVE_LIST         4
+#define PERFT_VARIANT_TT                5
+#define PERFT_VARIANT_TT_SINGLE_SLOT    6
+#define PERFT_VARIANT_TT_NO_SHALLOW     7
+#define PERFT_VARIANT_MOVE_LIST_TT      8
+#define NUM_PERFT_VARIANTS              9
+
+static const char *perftVariantNames[NUM_PERFT_VARIANTS] = { "default", "boards", "boards-generic", "boards-nocount", "movelist",
+                                                             "tt", "tt-single-slot", "tt-noshallow", "movelist-tt" };
+
+static int g_perftVariant = PERFT_VARIANT_DEFAULT;
+
+// if the variant is compiled into this build
+bool perftVariantAvailable(int variant)
+{
+    switch (variant)
+    {
+        case PERFT_VARIANT_DEFAULT:
+        case PERFT_VARIANT_BOARDS:
+        case PERFT_VARIANT_BOARDS_GENERIC:
+        case PERFT_VARIANT_BOARDS_NO_COUNT:
+        case PERFT_VARIANT_MOVE_LIST:
+        case PERFT_VARIANT_TT:
+        case PERFT_VARIANT_MOVE_LIST_TT:
+            return true;
+        case PERFT_VARIANT_TT_SINGLE_SLOT:
+            return TT_VARIANT_DUAL_SLOT;
+        case PERFT_VARIANT_TT_NO_SHALLOW:
+            return TT_VARIANT_SHALLOW_TT;
+        default:
+            return false;
+    }
+}
+
+// PerftVariant::flags of a variant
+uint32 perftVariantFlags(int variant)
+{
+    switch (variant)
+    {
+        case PERFT_VARIANT_BOARDS:          return BoardsVariant::flags;
+        case PERFT_VARIANT_BOARDS_GENERIC:  return BoardsGenericVariant::flags;
+        case PERFT_VARIANT_BOARDS_NO_COUNT: return BoardsNoCountVariant::flags;
+        case PERFT_VARIANT_MOVE_LIST:       return MoveListVariant::flags;
+        case PERFT_VARIANT_TT:              return TTVariant::flags;
+        case PERFT_VARIANT_TT_SINGLE_SLOT:  return TTSingleSlotVariant::flags;
+        case PERFT_VARIANT_TT_NO_SHALLOW:   return TTNoShallowVariant::flags;
+        case PERFT_VARIANT_MOVE_LIST_TT:    return MoveListTTVariant::flags;
+        default:                            return DefaultPerftVariant::flags;
+    }
+}
+
+// -1 if there is no such variant in this build
+int findPerftVariant(const char *name)
+{
+    for (int i = 0; i < NUM_PERFT_VARIANTS; i++)
+        if (strcmp(name, perftVariantNames[i]) == 0)
+            return perftVariantAvailable(i) ? i : -1;
+    return -1;
+}
+
+#endif
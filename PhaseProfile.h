@@ -0,0 +1,215 @@
+#ifndef PHASE_PROFILE_H
+#define PHASE_PROFILE_H
+
+// sampled hardware counters per phase of perft_bb, per depth and per thread (PROFILE_PHASES)
+// 1 in PHASE_SAMPLE_INTERVAL nodes at each depth is measured: the counters are read at the start of the node and
+// after each of its phases (the children's time is skipped, they are sampled at their own depth). The other nodes
+// only pay for a thread local counter increment, so this can stay on for real runs
+// counters come from PerfCounters.h: cycles, instructions, branch/L1d/LLC/dTLB misses with perf_event_open on
+// linux, rdtsc cycles only elsewhere (and wherever there is no pmu)
+//
+// included by MoveGeneratorBitboard.h
+
+#include "PerfCounters.h"
+#include "ThreadRegistry.h"
+
+#define PHASE_SAMPLE_INTERVAL   4096    // power of two
+#define PHASE_MAX_DEPTH         32      // deeper nodes aren't sampled
+
+#define PHASE_PROBE             0       // hash key + transposition table probe
+#define PHASE_GENERATE          1       // generateBoards
+#define PHASE_COUNT             2       // counting the moves of all the children of a leaf-parent
+#define PHASE_STORE             3       // transposition table store
+#define NUM_PHASES              4
+
+static const char *phaseNames[NUM_PHASES] = { "probe", "generate", "count", "store" };
+
+struct PhaseProfile
+{
+    PerfCounterGroup counters;
+    bool             hardware;          // false: cycles only (rdtsc)
+    uint64           calls[PHASE_MAX_DEPTH][NUM_PHASES];
+    uint64           events[PHASE_MAX_DEPTH][NUM_PHASES][NUM_PERF_GROUP_EVENTS];
+};
+
+// every thread that ever sampled a node
+static ThreadRegistry<PhaseProfile> phaseProfileRegistry;
+
+static THREAD_LOCAL PhaseProfile *threadPhaseProfile = NULL;
+static THREAD_LOCAL uint32        phaseVisits[PHASE_MAX_DEPTH];
+
+struct PhaseSample
+{
+    bool          active;
+    uint32        depth;
+    PhaseProfile *profile;
+    uint64        last[NUM_PERF_GROUP_EVENTS];
+};
+
+static void openPhaseProfile(PhaseProfile *profile)
+{
+    profile->hardware = perfGroupOpen(&profile->counters);
+}
+
+static PhaseProfile *getThreadPhaseProfile()
+{
+    if (threadPhaseProfile == NULL)
+        threadPhaseProfile = phaseProfileRegistry.add(openPhaseProfile);
+    return threadPhaseProfile;
+}
+
+MY_INLINE void phaseBegin(PhaseSample *sample, uint32 depth)
+{
+    sample->active = false;
+    if (depth >= PHASE_MAX_DEPTH || (++phaseVisits[depth] & (PHASE_SAMPLE_INTERVAL - 1)) != 0)
+        return;
+
+    sample->profile = getThreadPhaseProfile();
+    if (!sample->profile)
+        return;
+    sample->active = true;
+    sample->depth  = depth;
+    perfGroupRead(&sample->profile->counters, sample->last);
+}
+
+// everything since the last mark (or begin) was the given phase
+void phaseMark(PhaseSample *sample, int phase)
+{
+    uint64 now[NUM_PERF_GROUP_EVENTS];
+    perfGroupRead(&sample->profile->counters, now);
+
+    uint64 *events = sample->profile->events[sample->depth][phase];
+    for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+        events[i] += now[i] - sample->last[i];
+    sample->profile->calls[sample->depth][phase]++;
+
+    // (not counting the time spent in reading the counters)
+    perfGroupRead(&sample->profile->counters, sample->last);
+}
+
+// skip what was done since the last mark (e.g, the children)
+void phaseSkip(PhaseSample *sample)
+{
+    perfGroupRead(&sample->profile->counters, sample->last);
+}
+
+// call only when no search is running
+void resetPhaseProfile()
+{
+    for (int t = 0; t < phaseProfileRegistry.size(); t++)
+    {
+        PhaseProfile *profile = phaseProfileRegistry.at(t);
+        if (!profile)
+            continue;
+        memset(profile->calls,  0, sizeof(profile->calls));
+        memset(profile->events, 0, sizeof(profile->events));
+    }
+}
+
+static void printPhaseHeader(const char *first, bool hardware)
+{
+    printf("%5s  phase       samples  cycles/call  est. Mcyc", first);
+    if (hardware)
+    {
+        printf("    ipc");
+        for (int i = PERF_GROUP_BRANCH_MISSES; i < NUM_PERF_GROUP_EVENTS; i++)
+            printf(" %12s", perfGroupEventNames[i]);
+    }
+    printf("\n");
+}
+
+static void printPhaseEvents(uint64 calls, uint64 *events, bool hardware)
+{
+    printf("%10llu %12.0f %10.1f", calls, (double) events[PERF_GROUP_CYCLES] / calls,
+           (double) events[PERF_GROUP_CYCLES] * PHASE_SAMPLE_INTERVAL / 1e6);
+    if (hardware)
+    {
+        printf(" %6.2f", events[PERF_GROUP_CYCLES] ? (double) events[PERF_GROUP_INSTRUCTIONS] / events[PERF_GROUP_CYCLES] : 0.0);
+        for (int i = PERF_GROUP_BRANCH_MISSES; i < NUM_PERF_GROUP_EVENTS; i++)
+            printf(" %12.2f", (double) events[i] / calls);
+    }
+    printf("\n");
+}
+
+// per depth and phase totals over all threads, then per thread totals of each phase
+void printPhaseProfile()
+{
+    int numThreads = phaseProfileRegistry.size();
+    if (numThreads == 0)
+        return;
+
+    bool hardware = true;
+    uint64 totalCalls = 0;
+    for (int t = 0; t < numThreads; t++)
+    {
+        PhaseProfile *profile = phaseProfileRegistry.at(t);
+        if (!profile)
+            continue;
+        hardware &= profile->hardware;
+        for (int depth = 0; depth < PHASE_MAX_DEPTH; depth++)
+            for (int phase = 0; phase < NUM_PHASES; phase++)
+                totalCalls += profile->calls[depth][phase];
+    }
+    if (totalCalls == 0)
+        return;
+
+    printf("\nphase profile (1 in %d nodes sampled, %s, misses are per call)\n", PHASE_SAMPLE_INTERVAL,
+           hardware ? "hardware counters" : "rdtsc cycles only");
+    printPhaseHeader("depth", hardware);
+
+    for (int depth = PHASE_MAX_DEPTH - 1; depth >= 1; depth--)
+    {
+        for (int phase = 0; phase < NUM_PHASES; phase++)
+        {
+            uint64 calls = 0;
+            uint64 events[NUM_PERF_GROUP_EVENTS] = { 0 };
+            for (int t = 0; t < numThreads; t++)
+            {
+                PhaseProfile *profile = phaseProfileRegistry.at(t);
+                if (!profile)
+                    continue;
+                calls += profile->calls[depth][phase];
+                for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+                    events[i] += profile->events[depth][phase][i];
+            }
+            if (calls == 0)
+                continue;
+            printf("%5d  %-8s ", depth, phaseNames[phase]);
+            printPhaseEvents(calls, events, hardware);
+        }
+    }
+
+    if (numThreads > 1)
+    {
+        printf("\n");
+        printPhaseHeader("thread", hardware);
+        for (int t = 0; t < numThreads; t++)
+        {
+            PhaseProfile *profile = phaseProfileRegistry.at(t);
+            if (!profile)
+                continue;
+            for (int phase = 0; phase < NUM_PHASES; phase++)
+            {
+                uint64 calls = 0;
+                uint64 events[NUM_PERF_GROUP_EVENTS] = { 0 };
+                for (int depth = 0; depth < PHASE_MAX_DEPTH; depth++)
+                {
+                    calls += profile->calls[depth][phase];
+                    for (int i = 0; i < NUM_PERF_GROUP_EVENTS; i++)
+                        events[i] += profile->events[depth][phase][i];
+                }
+                if (calls == 0)
+                    continue;
+                printf("%5d  %-8s ", t, phaseNames[phase]);
+                printPhaseEvents(calls, events, hardware);
+            }
+        }
+    }
+}
+
+// phase markers for perft_bb (compile to nothing without PROFILE_PHASES)
+#define PHASE_BEGIN(depth)      PhaseSample phaseSample; phaseBegin(&phaseSample, depth);
+#define PHASE_MARK(phase)       if (phaseSample.active) phaseMark(&phaseSample, phase);
+#define PHASE_SKIP()            if (phaseSample.active) phaseSkip(&phaseSample);
+
+#endif
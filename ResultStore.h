@@ -0,0 +1,243 @@
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+// permanent store of exact perft results: (128 bit position key, depth) -> count
+// unlike the transposition tables nothing is ever replaced, and it lives across work units, roots and runs
+// - the file is a log that is only appended to: a small header followed by fixed size records
+// - on open all of it is read into an in memory index (open addressing, grows as needed)
+// - perft_bb looks up nodes at depth >= RESULT_STORE_MIN_DEPTH before searching them and adds them after
+// a record that was only partly written (crash while appending) fails its check and is cut off on the next open
+// - only used when asked for ("perft -store ..."). The header records the engine variant and the hash table setup
+//   that computed the results (a hash collision gets a wrong count stored for good), a file written by another
+//   variant or build is not used
+//
+// included by MoveGeneratorBitboard.h (needs zob and zob2)
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+// bump whenever the key or record format changes
+#define RESULT_STORE_VERSION        2
+
+// the hash table setup of the build, for the header
+#if USE_SHALLOW_TT == 1
+#define RESULT_STORE_HASH_SETUP     (TT_BITS | (SHALLOW_TT_BITS << 8))
+#else
+#define RESULT_STORE_HASH_SETUP     TT_BITS
+#endif
+
+// initial no of slots in the index (power of two), doubled when it gets half full
+#define RESULT_INDEX_INITIAL_BITS   16
+
+struct ResultStoreHeader
+{
+    char   magic[8];        // "perftRS"
+    uint32 version;         // RESULT_STORE_VERSION
+    uint32 recordSize;      // sizeof(ResultRecord)
+    uint64 zobristCheck[2]; // zobristChecksum() of zob and zob2, the keys are useless with any other ones
+    uint32 variant;         // PerftVariant::flags of the engine variant that computed the results
+    uint32 hashSetup;       // RESULT_STORE_HASH_SETUP
+};
+
+struct ResultRecord
+{
+    HashKey128b key;
+    uint64      count;
+    uint32      depth;
+    uint32      check;      // resultRecordCheck() of the above
+};
+CT_ASSERT(sizeof(ResultRecord) == 32);
+
+static const char resultStoreMagic[8] = "perftRS";
+
+struct ResultStore
+{
+    FILE             *fp;           // NULL when not open
+    ResultRecord     *index;        // depth == 0 for empty slots
+    uint64            indexSize;
+    uint64            numResults;
+    uint64            numLookups;
+    uint64            numFound;
+    CRITICAL_SECTION  lock;
+};
+
+static ResultStore resultStore;
+
+static uint32 resultRecordCheck(ResultRecord *record)
+{
+    uint64 mix = record->key.lowPart ^ (record->key.highPart * 0x9E3779B97F4A7C15ull) ^
+                 (record->count * 0xC2B2AE3D27D4EB4Full) ^ record->depth;
+    return (uint32) (mix ^ (mix >> 32)) | 1;    // never 0, so that a zeroed record doesn't pass
+}
+
+static uint64 resultIndexSlot(HashKey128b key, uint32 depth, uint64 indexSize)
+{
+    return (key.lowPart ^ (depth * 0x9E3779B97F4A7C15ull)) & (indexSize - 1);
+}
+
+// (doesn't check for duplicates)
+static void addToResultIndex(ResultRecord *record)
+{
+    if (2 * (resultStore.numResults + 1) > resultStore.indexSize)
+    {
+        ResultRecord *oldIndex = resultStore.index;
+        uint64 oldSize = resultStore.indexSize;
+
+        resultStore.indexSize = oldSize * 2;
+        resultStore.index = (ResultRecord *) calloc((size_t) resultStore.indexSize, sizeof(ResultRecord));
+        resultStore.numResults = 0;
+        for (uint64 i = 0; i < oldSize; i++)
+            if (oldIndex[i].depth)
+                addToResultIndex(&oldIndex[i]);
+        free(oldIndex);
+    }
+
+    uint64 slot = resultIndexSlot(record->key, record->depth, resultStore.indexSize);
+    while (resultStore.index[slot].depth)
+        slot = (slot + 1) & (resultStore.indexSize - 1);
+    resultStore.index[slot] = *record;
+    resultStore.numResults++;
+}
+
+static ResultRecord *findInResultIndex(HashKey128b key, uint32 depth)
+{
+    uint64 slot = resultIndexSlot(key, depth, resultStore.indexSize);
+    while (resultStore.index[slot].depth)
+    {
+        ResultRecord *record = &resultStore.index[slot];
+        if (record->depth == depth && record->key.lowPart == key.lowPart && record->key.highPart == key.highPart)
+            return record;
+        slot = (slot + 1) & (resultStore.indexSize - 1);
+    }
+    return NULL;
+}
+
+// open (or create) the store for the results of an engine variant (its PerftVariant::flags), and read what's in
+// it into the index
+bool openResultStore(const char *fileName, uint32 variant)
+{
+    ResultStoreHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, resultStoreMagic, sizeof(expected.magic));
+    expected.version         = RESULT_STORE_VERSION;
+    expected.recordSize      = sizeof(ResultRecord);
+    expected.zobristCheck[0] = zobristChecksum(zob);
+    expected.zobristCheck[1] = zobristChecksum(zob2);
+    expected.variant         = variant;
+    expected.hashSetup       = RESULT_STORE_HASH_SETUP;
+
+    resultStore.indexSize  = 1ull << RESULT_INDEX_INITIAL_BITS;
+    resultStore.index      = (ResultRecord *) calloc((size_t) resultStore.indexSize, sizeof(ResultRecord));
+    resultStore.numResults = 0;
+
+    FILE *fp = fopen(fileName, "rb+");
+    if (!fp)
+    {
+        fp = fopen(fileName, "wb+");
+        if (!fp || fwrite(&expected, sizeof(expected), 1, fp) != 1)
+        {
+            printf("\nFailed to create %s\n", fileName);
+            if (fp)
+                fclose(fp);
+            free(resultStore.index);
+            return false;
+        }
+        fflush(fp);
+    }
+    else
+    {
+        ResultStoreHeader header;
+        bool sameKeys = fread(&header, sizeof(header), 1, fp) == 1 &&
+                        memcmp(&header, &expected, offsetof(ResultStoreHeader, variant)) == 0;
+        if (!sameKeys || header.variant != expected.variant || header.hashSetup != expected.hashSetup)
+        {
+            if (sameKeys)
+                printf("\n%s was written by another engine variant or hash table setup, not using it\n", fileName);
+            else
+                printf("\n%s was written with different hash keys or format, not using it\n", fileName);
+            fclose(fp);
+            free(resultStore.index);
+            return false;
+        }
+
+        uint64 goodSize = sizeof(header);
+        ResultRecord record;
+        while (fread(&record, sizeof(record), 1, fp) == 1 && record.depth && record.check == resultRecordCheck(&record))
+        {
+            if (!findInResultIndex(record.key, record.depth))
+                addToResultIndex(&record);
+            goodSize += sizeof(record);
+        }
+
+        // cut off a partly written last record, so that new ones are appended right after the good ones
+        fflush(fp);
+#ifdef _WIN32
+        _chsize_s(_fileno(fp), goodSize);
+#else
+        if (ftruncate(fileno(fp), (off_t) goodSize) != 0)
+            printf("\nFailed to truncate %s\n", fileName);
+#endif
+        fseek(fp, 0, SEEK_END);
+    }
+
+    InitializeCriticalSection(&resultStore.lock);
+    resultStore.fp = fp;
+    printf("\n%s: %llu stored results\n", fileName, resultStore.numResults);
+    return true;
+}
+
+inline bool resultStoreOpen()
+{
+    return resultStore.fp != NULL;
+}
+
+bool lookupResult(HashKey128b key, uint32 depth, uint64 *count)
+{
+    EnterCriticalSection(&resultStore.lock);
+    resultStore.numLookups++;
+    ResultRecord *record = findInResultIndex(key, depth);
+    if (record)
+    {
+        *count = record->count;
+        resultStore.numFound++;
+    }
+    LeaveCriticalSection(&resultStore.lock);
+    return record != NULL;
+}
+
+// add a result (to the index, and appended to the file right away)
+void storeResult(HashKey128b key, uint32 depth, uint64 count)
+{
+    ResultRecord record;
+    record.key   = key;
+    record.count = count;
+    record.depth = depth;
+    record.check = resultRecordCheck(&record);
+
+    EnterCriticalSection(&resultStore.lock);
+    // another thread may have got to the same position meanwhile
+    if (!findInResultIndex(key, depth))
+    {
+        addToResultIndex(&record);
+        fwrite(&record, sizeof(record), 1, resultStore.fp);
+        fflush(resultStore.fp);
+    }
+    LeaveCriticalSection(&resultStore.lock);
+}
+
+void closeResultStore()
+{
+    if (!resultStore.fp)
+        return;
+    printf("\nresult store: %llu lookups, %llu found, %llu results\n", resultStore.numLookups, resultStore.numFound, resultStore.numResults);
+    fclose(resultStore.fp);
+    resultStore.fp = NULL;
+    free(resultStore.index);
+    resultStore.index = NULL;
+    DeleteCriticalSection(&resultStore.lock);
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef TT_SNAPSHOT_H
+#define TT_SNAPSHOT_H
+
+// snapshot of the transposition tables on disk, for warm restarts of long runs
+// the file is a header followed by the tables, each starting at a page aligned offset. On startup it is mapped
+// copy-on-write (so it's read in only as entries are probed, and the search never writes to the file) and used in
+// place of freshly allocated tables. A file is only used if it was written with the same table sizes, entry
+// layout and zobrist keys, otherwise we start with empty tables as usual
+//
+// included by MoveGeneratorBitboard.h (needs the tables and zob)
+// (the mapped tables are in small pages: neither OS gives huge pages for file mappings)
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// bump whenever the way entries are keyed or laid out changes
+// 2: generation byte in HashEntryPerft, lockless xor only over TT_HASH_BITS
+#define TT_SNAPSHOT_KEY_SCHEME  2
+
+#define TT_SNAPSHOT_ALIGN       4096
+#define TT_SNAPSHOT_NUM_TABLES  3       // TranspositionTable, ShallowTT, LeavesTT
+
+struct TTSnapshotHeader
+{
+    char   magic[8];                                // "perftTT"
+    uint32 keyScheme;                               // TT_SNAPSHOT_KEY_SCHEME
+    uint32 entrySize;                               // sizeof(TT_Entry)
+    uint32 flags;                                   // which of the TT options the tables were built with
+    uint32 generation;                              // ttGeneration when saved
+    uint64 zobristCheck;                            // zobristChecksum(zob)
+    uint64 tableOffset[TT_SNAPSHOT_NUM_TABLES];     // from the start of the file
+    uint64 tableSize[TT_SNAPSHOT_NUM_TABLES];       // in bytes, 0 for tables not in use
+};
+
+static const char ttSnapshotMagic[8] = "perftTT";
+
+// the mapped file (if any) the tables live in
+static void  *ttSnapshotBase = NULL;
+static uint64 ttSnapshotSize = 0;
+
+// what the snapshot written by this build would look like (the tables start right after the header)
+static void fillTTSnapshotHeader(TTSnapshotHeader *header)
+{
+    memset(header, 0, sizeof(TTSnapshotHeader));
+    memcpy(header->magic, ttSnapshotMagic, sizeof(header->magic));
+    header->keyScheme    = TT_SNAPSHOT_KEY_SCHEME;
+    header->entrySize    = sizeof(TT_Entry);
+    header->flags        = (USE_DUAL_SLOT_TT == 1)                 |
+                           (USE_LOCKLESS_HASH == 1)           << 1 |
+                           (USE_SHALLOW_TT == 1)              << 2 |
+                           (USE_TRANSPOSITION_AT_LEAVES == 1) << 3;
+    header->generation   = ttGeneration;
+    header->zobristCheck = zobristChecksum(zob);
+
+    header->tableSize[0] = (uint64) TT_SIZE * sizeof(TT_Entry);
+#if USE_SHALLOW_TT == 1
+    header->tableSize[1] = (uint64) SHALLOW_TT_SIZE * sizeof(uint64);
+#endif
+#if USE_TRANSPOSITION_AT_LEAVES == 1
+    header->tableSize[2] = (uint64) LEAVES_TT_SIZE * sizeof(uint64);
+#endif
+
+    uint64 offset = TT_SNAPSHOT_ALIGN;
+    for (int i = 0; i < TT_SNAPSHOT_NUM_TABLES; i++)
+    {
+        header->tableOffset[i] = offset;
+        offset += (header->tableSize[i] + TT_SNAPSHOT_ALIGN - 1) & ~((uint64) TT_SNAPSHOT_ALIGN - 1);
+    }
+}
+
+// map the tables from the file, returns false (and leaves the tables alone) if there is no usable snapshot
+bool loadTTSnapshot(const char *fileName)
+{
+    TTSnapshotHeader expected, header;
+    fillTTSnapshotHeader(&expected);
+    uint64 fileSize = expected.tableOffset[TT_SNAPSHOT_NUM_TABLES - 1] + expected.tableSize[TT_SNAPSHOT_NUM_TABLES - 1];
+
+    FILE *fp = fopen(fileName, "rb");
+    if (!fp)
+        return false;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1;
+    fclose(fp);
+
+    // everything but the generation has to match
+    expected.generation = header.generation;
+    if (!ok || memcmp(&header, &expected, sizeof(header)))
+    {
+        printf("\n%s doesn't match the current hash table setup, not using it\n", fileName);
+        return false;
+    }
+
+    void *base = NULL;
+#ifdef _WIN32
+    // FILE_SHARE_DELETE: so that saveTTSnapshot can move it out of the way while it's mapped
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if (GetFileSizeEx(file, &size) && (uint64) size.QuadPart >= fileSize)
+            mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (mapping)
+        {
+            base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, (SIZE_T) fileSize);
+            CloseHandle(mapping);   // the view keeps it alive
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(fileName, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (uint64) st.st_size >= fileSize)
+        {
+            base = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (base == MAP_FAILED)
+                base = NULL;
+            else
+                madvise(base, fileSize, MADV_WILLNEED);    // start reading it all in the background
+        }
+        close(fd);
+    }
+#endif
+    if (!base)
+    {
+        printf("\nFailed to map %s\n", fileName);
+        return false;
+    }
+
+    ttSnapshotBase = base;
+    ttSnapshotSize = fileSize;
+
+    uint8 *tables[TT_SNAPSHOT_NUM_TABLES];
+    HashTableInfo *infos[TT_SNAPSHOT_NUM_TABLES] = { &TTInfo, &ShallowTTInfo, &LeavesTTInfo };
+    for (int i = 0; i < TT_SNAPSHOT_NUM_TABLES; i++)
+    {
+        tables[i] = header.tableSize[i] ? (uint8 *) base + header.tableOffset[i] : NULL;
+
+        // usable right away: pages are read from the file as they are touched
+        memset(infos[i], 0, sizeof(HashTableInfo));
+        infos[i]->ready = true;
+        infos[i]->mem   = tables[i];
+        infos[i]->size  = header.tableSize[i];
+    }
+    TranspositionTable = (TT_Entry *) tables[0];
+    ShallowTT          = (uint64 *)   tables[1];
+    LeavesTT           = (uint64 *)   tables[2];
+
+    // entries from the snapshot count as old ones
+    ttGeneration = (uint8) header.generation;
+    newTTGeneration();
+
+    printf("\nhash tables mapped from %s: %llu MB\n", fileName, fileSize >> 20);
+    return true;
+}
+
+// write the tables out (to a temp file first, so that a crash while saving doesn't lose the previous snapshot)
+// can be called while the search is running: entries are checked on probe (USE_LOCKLESS_HASH), so the ones that
+// were being written while we copied them just won't hit after a reload
+bool saveTTSnapshot(const char *fileName)
+{
+    TTSnapshotHeader header;
+    fillTTSnapshotHeader(&header);
+
+    char tempName[1024];
+    sprintf(tempName, "%s.tmp", fileName);
+    FILE *fp = fopen(tempName, "wb");
+    if (!fp)
+    {
+        printf("\nFailed to create %s\n", tempName);
+        return false;
+    }
+
+    static uint8 padding[TT_SNAPSHOT_ALIGN];
+    uint8 *tables[TT_SNAPSHOT_NUM_TABLES] = { (uint8 *) TranspositionTable, (uint8 *) ShallowTT, (uint8 *) LeavesTT };
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(padding, TT_SNAPSHOT_ALIGN - sizeof(header), 1, fp) == 1;
+    for (int i = 0; ok && i < TT_SNAPSHOT_NUM_TABLES; i++)
+    {
+        if (header.tableSize[i] == 0)
+            continue;
+        ok = fwrite(tables[i], (size_t) header.tableSize[i], 1, fp) == 1;
+        uint64 pad = (TT_SNAPSHOT_ALIGN - header.tableSize[i] % TT_SNAPSHOT_ALIGN) % TT_SNAPSHOT_ALIGN;
+        if (ok && pad)
+            ok = fwrite(padding, (size_t) pad, 1, fp) == 1;
+    }
+    ok = (fclose(fp) == 0) && ok;
+
+#ifdef _WIN32
+    // a file that is mapped can't be replaced (but can be renamed), and the one we loaded from still is
+    char oldName[1024];
+    sprintf(oldName, "%s.old", fileName);
+    DeleteFileA(oldName);
+    MoveFileExA(fileName, oldName, MOVEFILE_REPLACE_EXISTING);
+    ok = ok && MoveFileExA(tempName, fileName, MOVEFILE_REPLACE_EXISTING);
+    DeleteFileA(oldName);   // fails while mapped, removed by the next save then
+#else
+    ok = ok && rename(tempName, fileName) == 0;
+#endif
+
+    if (!ok)
+    {
+        printf("\nFailed to save hash tables to %s\n", fileName);
+        remove(tempName);
+    }
+    return ok;
+}
+
+// unmap the tables if they came from a snapshot, returns false if they didn't
+bool unmapTTSnapshot()
+{
+    if (!ttSnapshotBase)
+        return false;
+#ifdef _WIN32
+    UnmapViewOfFile(ttSnapshotBase);
+#else
+    munmap(ttSnapshotBase, ttSnapshotSize);
+#endif
+    ttSnapshotBase = NULL;
+    TranspositionTable = NULL;
+    ShallowTT = NULL;
+    LeavesTT = NULL;
+    return true;
+}
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef TABLE_MEMORY_H
+#define TABLE_MEMORY_H
+
+// memory for the big (multi GB) hash tables
+// - huge pages (see HugePages.h): probes are random, with 4 KB pages almost every one of them is a TLB miss
+// - pages interleaved over all NUMA nodes: every thread probes the whole table, so no node is better than another
+//   for any page, but all of them on the node of the main thread makes the other socket(s) pay remote latency
+//   on every probe and saturates one memory controller
+// - not zeroed or even touched before the search starts (LAZY_TABLE_ZEROING), otherwise zeroed by one thread per core
+//
+// linux: interleaving is done with mbind(MPOL_INTERLEAVE) before the pages are touched
+// windows: zeroing threads are bound to the nodes round robin and the pages end up where they are first touched
+//          (large pages are physically allocated by VirtualAlloc itself, and are placed by the OS)
+
+#include "chess.h"
+#include "HugePages.h"
+
+#ifndef _WIN32
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/resource.h>
+#endif
+
+// memory fresh from the OS is always zero, so new tables don't need a memset. But just leaving the page faults to the
+// search doesn't work: probes are random and even a perft 5 touches most of the 2 MB pages of a multi GB table.
+// Instead low priority background threads fault the table in, 2 MB at a time, and the search treats the parts that
+// aren't ready yet as empty (probes miss and stores are dropped, see hashTableReady)
+// startup doesn't depend on the table size at all then (except for windows large pages, which VirtualAlloc zeroes)
+// set to 0 to fault in and zero everything up front using all cores
+#define LAZY_TABLE_ZEROING 1
+
+// explicitly allocated large pages are resident (and zeroed) as soon as allocPages returns on windows
+// (explicit huge pages on linux are faulted in on first touch like any other page)
+#ifdef _WIN32
+#define HUGE_PAGES_ZEROED_ON_ALLOC 1
+#else
+#define HUGE_PAGES_ZEROED_ON_ALLOC 0
+#endif
+
+// tables are zeroed in chunks of this size, chunk i by thread (i % no of threads)
+#define ZERO_CHUNK_SIZE  HUGE_PAGE_SIZE
+#define MAX_ZERO_THREADS 256
+
+int getNumProcessors()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    return (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+int getNumNumaNodes()
+{
+    int numNodes = 1;
+#ifdef _WIN32
+    ULONG highestNode = 0;
+    if (GetNumaHighestNodeNumber(&highestNode))
+        numNodes = highestNode + 1;
+#else
+    // e.g, "0-1" on a dual socket box
+    FILE *fp = fopen("/sys/devices/system/node/online", "r");
+    if (fp)
+    {
+        int first = 0, last = 0;
+        int n = fscanf(fp, "%d-%d", &first, &last);
+        if (n == 2)
+            numNodes = last + 1;
+        fclose(fp);
+    }
+#endif
+    if (numNodes > 64)
+        numNodes = 64;
+    return numNodes;
+}
+
+struct ZeroTableJob
+{
+    uint8  *mem;
+    size_t  size;
+    int     thread;
+    int     numThreads;
+    int     numNodes;
+};
+
+DWORD WINAPI zeroTableThread(LPVOID lpParam)
+{
+    ZeroTableJob *job = (ZeroTableJob *) lpParam;
+
+#ifdef _WIN32
+    // first touch decides the node of a (small) page on windows
+    if (job->numNodes > 1)
+    {
+        ULONGLONG nodeMask = 0;
+        if (GetNumaNodeProcessorMask((UCHAR) (job->thread % job->numNodes), &nodeMask) && nodeMask)
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) nodeMask);
+    }
+#endif
+
+    size_t numChunks = (job->size + ZERO_CHUNK_SIZE - 1) / ZERO_CHUNK_SIZE;
+    for (size_t chunk = job->thread; chunk < numChunks; chunk += job->numThreads)
+    {
+        size_t offset = chunk * ZERO_CHUNK_SIZE;
+        size_t bytes  = job->size - offset < ZERO_CHUNK_SIZE ? job->size - offset : ZERO_CHUNK_SIZE;
+        memset(job->mem + offset, 0, bytes);
+    }
+    return 0;
+}
+
+// clear the table using all cores (for reusing a table, new ones are already zero)
+void zeroTable(void *mem, size_t size)
+{
+    static ZeroTableJob jobs[MAX_ZERO_THREADS];
+    HANDLE threads[MAX_ZERO_THREADS];
+
+    int numThreads = getNumProcessors();
+    if (numThreads > MAX_ZERO_THREADS)
+        numThreads = MAX_ZERO_THREADS;
+    if ((size_t) numThreads > size / ZERO_CHUNK_SIZE)
+        numThreads = (int) (size / ZERO_CHUNK_SIZE);
+
+    if (numThreads <= 1)
+    {
+        memset(mem, 0, size);
+        return;
+    }
+
+    int numNodes = getNumNumaNodes();
+    for (int i = 0; i < numThreads; i++)
+    {
+        jobs[i].mem        = (uint8 *) mem;
+        jobs[i].size       = size;
+        jobs[i].thread     = i;
+        jobs[i].numThreads = numThreads;
+        jobs[i].numNodes   = numNodes;
+        threads[i] = CreateThread(NULL, 0, zeroTableThread, &jobs[i], 0, NULL);
+    }
+    WaitForMultipleObjects(numThreads, threads, TRUE, INFINITE);
+    for (int i = 0; i < numThreads; i++)
+        CloseHandle(threads[i]);
+}
+
+// state of a table being faulted in by the background threads
+struct HashTableInfo
+{
+    volatile bool   ready;          // the whole table can be used
+    volatile uint8 *chunkReady;     // otherwise: one flag per 2 MB chunk
+    volatile long   nextChunk;      // next chunk for the background threads
+    volatile long   threadsRunning;
+    volatile long   threadsStarted;
+    uint8          *mem;
+    size_t          size;
+};
+
+// whether the entry at the given byte offset of the table can be probed/stored
+inline bool hashTableReady(HashTableInfo *info, size_t offset)
+{
+    return info->ready || info->chunkReady[offset >> HUGE_PAGE_SHIFT];
+}
+
+DWORD WINAPI warmUpTableThread(LPVOID lpParam)
+{
+    HashTableInfo *info = (HashTableInfo *) lpParam;
+
+    // don't take cpu time away from the search
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+
+    // same as zeroTableThread: first touch places the page
+    int numNodes = getNumNumaNodes();
+    if (numNodes > 1)
+    {
+        ULONGLONG nodeMask = 0;
+        int node = (InterlockedIncrement(&info->threadsStarted) - 1) % numNodes;
+        if (GetNumaNodeProcessorMask((UCHAR) node, &nodeMask) && nodeMask)
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) nodeMask);
+    }
+#else
+    setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), 19);
+#endif
+
+    size_t numChunks = (info->size + HUGE_PAGE_SIZE - 1) >> HUGE_PAGE_SHIFT;
+    while (true)
+    {
+        size_t chunk = (size_t) (InterlockedIncrement(&info->nextChunk) - 1);
+        if (chunk >= numChunks)
+            break;
+
+        // the memory is zero already, a write to every 4 KB page faults it in
+        size_t end = (chunk + 1) << HUGE_PAGE_SHIFT;
+        if (end > info->size)
+            end = info->size;
+        for (size_t offset = chunk << HUGE_PAGE_SHIFT; offset < end; offset += 4096)
+            ((volatile uint8 *) info->mem)[offset] = 0;
+
+        info->chunkReady[chunk] = 1;
+    }
+
+    // the last one to finish marks the table ready (all chunks have been picked up and finished by then)
+    if (InterlockedDecrement(&info->threadsRunning) == 0)
+        info->ready = true;
+
+    return 0;
+}
+
+// returns the no of nodes the pages will be spread over
+int interleaveOverNumaNodes(void *mem, size_t size)
+{
+    int numNodes = getNumNumaNodes();
+#ifndef _WIN32
+    if (numNodes > 1)
+    {
+        unsigned long nodeMask = (numNodes == 64) ? ~0ul : ((1ul << numNodes) - 1);
+        if (syscall(__NR_mbind, mem, size, MPOL_INTERLEAVE, &nodeMask, sizeof(nodeMask) * 8, 0) != 0)
+            numNodes = 1;
+    }
+#endif
+    return numNodes;
+}
+
+// allocate a zeroed hash table (name is only for printing)
+// with info: the table is a cache (transposition tables) and is faulted in by background threads,
+//            the caller must check hashTableReady() before every probe or store
+// without:   every entry must be usable right away (e.g, the unique positions table). With LAZY_TABLE_ZEROING the
+//            table is left to be faulted in by the search itself, in 4 KB pages so that each first touch is cheap
+void *allocHashTable(size_t size, const char *name, HashTableInfo *info = NULL)
+{
+    int pageType;
+    bool hugePages = (LAZY_TABLE_ZEROING != 1) || info;
+    void *mem = allocPages(size, hugePages, &pageType);
+    if (mem == NULL)
+    {
+        printf("\nFailed to allocate %s of %llu bytes\n", name, (uint64) size);
+        return NULL;
+    }
+
+    int numNodes = interleaveOverNumaNodes(mem, size);
+
+    if (info)
+    {
+        memset(info, 0, sizeof(HashTableInfo));
+        info->mem  = (uint8 *) mem;
+        info->size = size;
+#if LAZY_TABLE_ZEROING == 1
+        if (pageType != PAGES_HUGE || HUGE_PAGES_ZEROED_ON_ALLOC == 0)
+        {
+            size_t numChunks = (size + HUGE_PAGE_SIZE - 1) >> HUGE_PAGE_SHIFT;
+            info->chunkReady = (volatile uint8 *) calloc(numChunks, 1);
+
+            int numThreads = getNumProcessors();
+            info->threadsRunning = numThreads;
+            for (int i = 0; i < numThreads; i++)
+                CloseHandle(CreateThread(NULL, 0, warmUpTableThread, info, 0, NULL));
+        }
+        else
+#endif
+        {
+            info->ready = true;
+        }
+    }
+
+#if LAZY_TABLE_ZEROING != 1
+    zeroTable(mem, size);
+#endif
+
+    printf("\n%s: %llu MB in %s", name, (uint64) (size >> 20), pageTypeNames[pageType]);
+    if (numNodes > 1)
+        printf(", spread over %d numa nodes", numNodes);
+    printf("\n");
+
+    return mem;
+}
+
+void freeHashTable(void *mem, size_t size, HashTableInfo *info = NULL)
+{
+    if (info)
+    {
+        // background threads may still be touching it
+        while (info->threadsRunning)
+            Sleep(1);
+        free((void *) info->chunkReady);
+        info->chunkReady = NULL;
+        info->ready = false;
+    }
+    freePages(mem, size);
+}
+
+#endif
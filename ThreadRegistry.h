@@ -0,0 +1,50 @@
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+// per thread blocks of diagnostic counters (NodeStats.h, PerftStats.h, PhaseProfile.h) that other threads can read
+// while a search runs. The blocks are never freed, so that the reports include threads that have exited
+// a thread reserves its slot before it publishes the pointer: readers must skip the slots that are still NULL
+//
+// included by NodeStats.h, PerftStats.h and PhaseProfile.h
+
+#define MAX_REGISTRY_THREADS    1024
+
+template <class T>
+struct ThreadRegistry
+{
+    T * volatile  slots[MAX_REGISTRY_THREADS];
+    volatile long count;
+
+    // a zeroed block for the calling thread (after init, if given), NULL if all the slots are taken
+    // (keep it in a THREAD_LOCAL: every call adds a block)
+    T *add(void (*init)(T *) = NULL)
+    {
+        long index = InterlockedIncrement(&count) - 1;
+        if (index >= MAX_REGISTRY_THREADS)
+        {
+            InterlockedDecrement(&count);
+            return NULL;
+        }
+        T *block = (T *) calloc(1, sizeof(T));
+        if (init)
+            init(block);
+        // (full barrier: the block's contents are visible before the pointer)
+        InterlockedExchangePointer((PVOID volatile *) &slots[index], block);
+        return block;
+    }
+
+    // no of slots taken, some of them may not be published yet
+    int size()
+    {
+        long n = count;
+        return n < MAX_REGISTRY_THREADS ? (int) n : MAX_REGISTRY_THREADS;
+    }
+
+    // NULL if the thread hasn't published its block yet
+    T *at(int t)
+    {
+        return slots[t];
+    }
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef WORKER_TRACE_H
+#define WORKER_TRACE_H
+
+// timeline of the verification mode threads (TRACE_WORKERS), written as chrome trace json
+// (open in chrome://tracing or ui.perfetto.dev) to show idle threads, long running records and writer stalls
+// every thread appends spans to its own buffer (no locks, no shared writes), the buffers are only read after all
+// the worker threads have exited. Spans that don't fit in the buffer of a thread are dropped (and counted)
+//
+// included by perft.cpp
+
+#define TRACE_BUFFER_EVENTS     (1 << 17)       // per thread, 32 bytes each
+#define MAX_TRACE_THREADS       (MAX_THREADS + 1)
+
+struct TraceEvent
+{
+    const char *name;
+    uint64      start;      // QueryPerformanceCounter ticks
+    uint64      end;
+    int         arg;        // e.g, record id, -1 for none
+};
+
+struct TraceBuffer
+{
+    const char *threadName;
+    int         threadId;
+    int         numEvents;
+    int         dropped;
+    TraceEvent  events[TRACE_BUFFER_EVENTS];
+};
+
+static TraceBuffer   *traceBuffers[MAX_TRACE_THREADS];
+static volatile long  numTraceBuffers = 0;
+static uint64         traceOrigin;
+static uint64         traceFreq;
+
+static THREAD_LOCAL TraceBuffer *threadTraceBuffer = NULL;
+
+MY_INLINE uint64 traceNow()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+// call before starting the threads
+void traceInit()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    traceFreq = frequency.QuadPart;
+    traceOrigin = traceNow();
+}
+
+// once in every thread that records spans
+void traceThread(const char *name, int id)
+{
+    long index = InterlockedIncrement(&numTraceBuffers) - 1;
+    if (index >= MAX_TRACE_THREADS)
+    {
+        InterlockedDecrement(&numTraceBuffers);
+        return;
+    }
+    TraceBuffer *buffer = (TraceBuffer *) malloc(sizeof(TraceBuffer));
+    buffer->threadName = name;
+    buffer->threadId   = id;
+    buffer->numEvents  = 0;
+    buffer->dropped    = 0;
+    traceBuffers[index] = buffer;
+    threadTraceBuffer = buffer;
+}
+
+// a span from start till now
+MY_INLINE void traceSpan(const char *name, uint64 start, int arg)
+{
+    TraceBuffer *buffer = threadTraceBuffer;
+    if (!buffer)
+        return;
+    if (buffer->numEvents == TRACE_BUFFER_EVENTS)
+    {
+        buffer->dropped++;
+        return;
+    }
+    TraceEvent *event = &buffer->events[buffer->numEvents++];
+    event->name  = name;
+    event->start = start;
+    event->end   = traceNow();
+    event->arg   = arg;
+}
+
+static double traceMicroseconds(uint64 ticks)
+{
+    return (double) (ticks - traceOrigin) * 1000000.0 / traceFreq;
+}
+
+// call only after all the traced threads are done
+bool writeTrace(const char *fileName)
+{
+    FILE *fp = fopen(fileName, "w");
+    if (!fp)
+    {
+        printf("\nFailed to create %s\n", fileName);
+        return false;
+    }
+
+    int numThreads = (int) numTraceBuffers;
+    int dropped = 0;
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (int t = 0; t < numThreads; t++)
+    {
+        TraceBuffer *buffer = traceBuffers[t];
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+                t ? ",\n" : "", t, buffer->threadName, buffer->threadId);
+
+        for (int i = 0; i < buffer->numEvents; i++)
+        {
+            TraceEvent *event = &buffer->events[i];
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                    event->name, t, traceMicroseconds(event->start), traceMicroseconds(event->end) - traceMicroseconds(event->start));
+            if (event->arg >= 0)
+                fprintf(fp, ", \"args\": {\"id\": %d}", event->arg);
+            fprintf(fp, "}");
+        }
+        dropped += buffer->dropped;
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    printf("\ntrace written to %s", fileName);
+    if (dropped)
+        printf(" (%d spans dropped, buffers full)", dropped);
+    printf("\n");
+    return true;
+}
+
+#define TRACE_BEGIN(span)               uint64 span = traceNow();
+#define TRACE_END(span, name, arg)      traceSpan(name, span, arg);
+
+#endif
@@ -37,6 +37,13 @@ int __static_assert(int static_assert_failed[(expr)?1:-1])
 
 #define BIT(i)   (1ULL << (i))
 
+// a separate instance of the variable for every thread
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 // Terminology:
 //
 // file - column [A - H]
@@ -377,10 +384,11 @@ struct HashEntryPerft
         uint64 hashKey;
         struct
         {
-            // 8 LSB's are not important as the hash table size is at least > 256 entries
-            // store depth in the 8 LSB's
+            // 16 LSB's are not important as the hash table size is at least 2 ^ 16 entries
+            // store depth in the 8 LSB's, and the generation the entry was written in the next 8
             uint8 depth;
-            uint8 hashPart[7];  // most significant bits of the hash key
+            uint8 generation;
+            uint8 hashPart[6];  // most significant bits of the hash key
         };
     };
     uint64 perftVal;
@@ -399,6 +407,13 @@ struct DualHashEntry
 };
 CT_ASSERT(sizeof(DualHashEntry) == 32);
 
+// two 64 bit zobrist keys computed with different random numbers
+struct HashKey128b
+{
+    uint64 lowPart;
+    uint64 highPart;
+};
+
 struct ShallowHashEntry
 {
     union
@@ -7,6 +7,16 @@
 
 #define FIND_UNIQUES 1
 
+// record a timeline of the threads in verification mode, written to <input file>.trace.json (see WorkerTrace.h)
+#define TRACE_WORKERS 0
+
+// run the bench suite (see BenchSuite.h) with the lookup tables in small pages and in a huge page (see HotTables)
+// and report the dTLB and L1 miss rates of both
+#define BENCH_HOT_TABLES 0
+
+// regenerate AttackTables.h (needs USE_GENERATED_TABLES set to 0 so that init() builds the tables)
+#define GENERATE_ATTACK_TABLES 0
+
 // for timing CPU code : start
 double gTime;
 LARGE_INTEGER freq;
@@ -48,17 +58,32 @@ struct perft14wu
     volatile unsigned int nextRecord;
     unsigned int totalRecords;
     unsigned int preProcessedRecords;
+    unsigned int numThreads;
 
     // most recent record processed by each thread
     volatile int mostRecentProcessed[MAX_THREADS];
+
+    // records done by each thread and the sum of their perft counts (for the status, see CampaignStatus.h)
+    volatile int    recordsDone[MAX_THREADS];
+    volatile uint64 nodesDone[MAX_THREADS];
 } g_WorkUnit;
 
-clock_t start, end;
+#include "CampaignStatus.h"
+
+#if TRACE_WORKERS == 1
+#include "WorkerTrace.h"
+#else
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name, arg)
+#endif
 
 DWORD WINAPI workerThread(LPVOID lpParam)
 {
     BoardPosition testBoard;
     int threadIndex = (int) lpParam;
+#if TRACE_WORKERS == 1
+    traceThread("worker", threadIndex);
+#endif
     
     while (true)
     {
@@ -68,6 +93,17 @@ DWORD WINAPI workerThread(LPVOID lpParam)
         if (recordIdToProcess >= g_WorkUnit.totalRecords)
             break;
 
+        TRACE_BEGIN(recordSpan)
+
+        // the hash is kept across records, entries of older ones just get replaced first
+        // (one generation per round of records, so that the ones still running on other threads stay current)
+        if (recordIdToProcess % g_WorkUnit.numThreads == 0)
+        {
+            TRACE_BEGIN(generationSpan)
+            newTTGeneration();
+            TRACE_END(generationSpan, "new tt generation", -1)
+        }
+
         char *line = g_WorkUnit.input[recordIdToProcess];
 
         Utils::readFENString(line, &testBoard);
@@ -78,7 +114,11 @@ DWORD WINAPI workerThread(LPVOID lpParam)
 
         Utils::board088ToHexBB(&testBB, &testBoard);
 
+#if USE_INTERLEAVED_PERFT == 1
+        uint64 res = perft_interleaved(&testBB, 7);
+#else
         uint64 res = perft_bb(&testBB, 0, 7);
+#endif
 
         // write to output file
         removeNewLine(line);
@@ -90,16 +130,11 @@ DWORD WINAPI workerThread(LPVOID lpParam)
         int occCount = atoi(ptr);
 
         sprintf(g_WorkUnit.output[recordIdToProcess], "%s %llu %llu\n", line, res, res * occCount);
+        TRACE_END(recordSpan, "record", recordIdToProcess)
 
-        end = clock();
-        double t = ((double)end - start) / CLOCKS_PER_SEC;
-        printf("\nTID: %d: record id: %d\n%sRecords done: %d, Total: %g seconds, Avg: %g seconds\n", threadIndex, recordIdToProcess,
-                    g_WorkUnit.output[recordIdToProcess], 
-                    recordIdToProcess + g_WorkUnit.preProcessedRecords + 1,
-                    t, t / (recordIdToProcess+1));
-
-        fflush(stdout);
-
+        // no printing here: the main thread reports the progress (see CampaignStatus.h)
+        g_WorkUnit.nodesDone[threadIndex] += res;
+        g_WorkUnit.recordsDone[threadIndex]++;
         g_WorkUnit.mostRecentProcessed[threadIndex] = recordIdToProcess;
 
     }
@@ -108,17 +143,206 @@ DWORD WINAPI workerThread(LPVOID lpParam)
 }
 
 #include "uniques.h"
+#include "BenchSuite.h"
+#include "BenchCompare.h"
+#include "MicroBench.h"
+
+#if BENCH_HOT_TABLES == 1 && USE_HOT_TABLE_ARENA == 1
+#include "PerfCounters.h"
+
+void benchHotTables()
+{
+    PerfCounters pc;
+    bool havePerfCounters = perfCountersOpen(&pc);
+    if (!havePerfCounters)
+        printf("\nhardware counters not available, only showing timings\n");
+
+    printf("\nusing %s for sliding piece attacks\n", sliderBackendNames[g_sliderBackend]);
+
+    for (int hugePages = 0; hugePages <= 1; hugePages++)
+    {
+        initHotTables(hugePages == 1);
+        printf("\nlookup tables in %s:\n", pageTypeNames[hotTablesPageType]);
+
+        uint64 totalNodes = 0;
+        double totalTime = 0;
+
+        perfCountersStart(&pc);
+        for (int i = 0; i < (int) NUM_BENCH_CASES; i++)
+        {
+            uint64 bbMoves;
+            START_TIMER
+            bbMoves = runBenchCase(&benchCases[i]);
+            STOP_TIMER
+
+            totalNodes += bbMoves;
+            totalTime  += gTime;
+        }
+        perfCountersStop(&pc);
+
+        printf("nodes: %llu, %g seconds, nps: %llu\n", totalNodes, totalTime / 1000.0, (uint64) ((totalNodes / totalTime) * 1000.0));
+        if (havePerfCounters)
+        {
+            printf("dTLB load misses: %llu (%.4f%% of loads), L1d load misses: %llu (%.3f%% of loads)\n",
+                   pc.value[PERF_DTLB_LOAD_MISSES], perfMissRate(&pc, PERF_DTLB_LOADS, PERF_DTLB_LOAD_MISSES),
+                   pc.value[PERF_L1D_LOAD_MISSES],  perfMissRate(&pc, PERF_L1D_LOADS,  PERF_L1D_LOAD_MISSES));
+        }
+    }
+
+    perfCountersClose(&pc);
+}
+#endif
 
 int main(int argc, char *argv[])
 {
     BoardPosition testBoard;
+
+    // options, in any order before the mode:
+    //   -stats            run the instrumented instance of the perft drivers (see PerftStats.h)
+    //   -variant <name>   run one of the other engine variants compiled in (see PerftVariants.h)
+    //   -store            look up and keep results in the permanent result store (see ResultStore.h)
+    //   -tier <name>      run the code path of a lower cpu tier than the detected one (see CpuFeatures.h)
+    //   -backend <name>   sliding piece attack generator to use instead of the default one (see setSliderBackend)
+    int variant = PERFT_VARIANT_DEFAULT;
+    int tier = -1;
+    int backend = -1;
+#if USE_RESULT_STORE == 1
+    bool useResultStore = false;
+#endif
+    while (argc >= 2 && argv[1][0] == '-')
+    {
+        if (strcmp(argv[1], "-stats") == 0)
+        {
+            g_perftStats = true;
+        }
+        else if (strcmp(argv[1], "-variant") == 0 && argc >= 3)
+        {
+            variant = findPerftVariant(argv[2]);
+            if (variant < 0)
+            {
+                printf("\nno %s engine variant in this build, available:", argv[2]);
+                for (int i = 0; i < NUM_PERFT_VARIANTS; i++)
+                    if (perftVariantAvailable(i))
+                        printf(" %s", perftVariantNames[i]);
+                printf("\n");
+                return 2;
+            }
+            argc--;
+            argv++;
+        }
+        else if (strcmp(argv[1], "-tier") == 0 && argc >= 3)
+        {
+            tier = findCpuTier(argv[2]);
+            if (tier < 0)
+            {
+                printf("\nno %s cpu tier, available:", argv[2]);
+                for (int i = 0; i < NUM_CPU_TIERS; i++)
+                    printf(" %s", cpuTierNames[i]);
+                printf("\n");
+                return 2;
+            }
+            argc--;
+            argv++;
+        }
+        else if (strcmp(argv[1], "-backend") == 0 && argc >= 3)
+        {
+            backend = findSliderBackend(argv[2]);
+            if (backend < 0)
+            {
+                printf("\nno %s slider backend, available:", argv[2]);
+                for (int i = 0; i < NUM_SLIDER_BACKENDS; i++)
+                    printf(" %s", sliderBackendOptions[i]);
+                printf("\n");
+                return 2;
+            }
+            argc--;
+            argv++;
+        }
+#if USE_RESULT_STORE == 1
+        else if (strcmp(argv[1], "-store") == 0)
+        {
+            useResultStore = true;
+        }
+#endif
+        else
+        {
+            printf("\nunknown option %s\n", argv[1]);
+            return 2;
+        }
+        argc--;
+        argv++;
+    }
+
     MoveGeneratorBitboard::init();
 
+    if (tier >= 0)
+    {
+        if (tier > g_cpuTierDetected)
+        {
+            printf("\nthe %s code path needs a newer cpu than this one\n", cpuTierNames[tier]);
+            return 2;
+        }
+        setCpuTier(tier);
+        // (pext and the simd passes are only compiled into the avx2 and later instances)
+        if (backend < 0)
+            setSliderBackend(g_sliderBackend);
+        printf("\nusing %s code path\n", cpuTierNames[g_cpuTier]);
+    }
+
+    if (backend >= 0)
+    {
+        setSliderBackend(backend);
+        printf("\nusing %s for sliding piece attacks\n", sliderBackendNames[g_sliderBackend]);
+    }
+
+    // (after init: allocates the hash tables if the variant uses them)
+    setPerftVariant(variant);
+
+#if GENERATE_ATTACK_TABLES == 1
+    writeAttackTables("AttackTables.h");
+    return 0;
+#endif
+
+#if BENCH_HOT_TABLES == 1 && USE_HOT_TABLE_ARENA == 1
+    benchHotTables();
+    return 0;
+#endif
+
+    // fixed set of positions with known counts, for comparable speed numbers (see BenchSuite.h)
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+        return runBench(argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_REPEATS, argc >= 4 ? argv[3] : BENCH_DEFAULT_FILE);
+
+    // the bench suite with every engine variant in this build
+    if (argc >= 2 && strcmp(argv[1], "variants") == 0)
+        return runVariantBench(argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_REPEATS);
+
+    // the bench suite with every slider backend, optional argument: no of threads to run it on at once as well
+    if (argc >= 2 && strcmp(argv[1], "backends") == 0)
+        return runBackendBench(argc >= 3 ? atoi(argv[2]) : 1);
+
+    // the bench suite with every cpu tier this cpu supports
+    if (argc >= 2 && strcmp(argv[1], "tiers") == 0)
+        return runTierBench(argc >= 3 ? atoi(argv[2]) : BENCH_DEFAULT_REPEATS);
+
+    // compare two bench results: exits with 1 on a significant slowdown (see BenchCompare.h)
+    if (argc >= 4 && strcmp(argv[1], "compare") == 0)
+        return compareBench(argv[2], argv[3], argc >= 5 ? atof(argv[4]) : BENCH_COMPARE_THRESHOLD);
+
+    // ns and cycles per call of the generator primitives (see MicroBench.h)
+    if (argc >= 2 && strcmp(argv[1], "micro") == 0)
+        return runMicroBench();
+
 #if FIND_UNIQUES == 1
     findUniques(3);
     return 0;
 #endif
 
+#if USE_RESULT_STORE == 1
+    // results computed by earlier runs/work units (with the same engine variant) are never searched again
+    if (useResultStore)
+        openResultStore(RESULT_STORE_FILE, perftVariantFlags(g_perftVariant));
+#endif
+
     if (argc >= 2)
     {
         // perft verification mode
@@ -136,8 +360,6 @@ int main(int argc, char *argv[])
 
         fseek(fpOp, 0, SEEK_SET);
 
-        start = clock();
-
         char line[MAX_RECORD_SIZE];
 
         int j = 0;  // records to process
@@ -171,6 +393,17 @@ int main(int argc, char *argv[])
         if (numThreads < 1 || numThreads > MAX_THREADS)
             numThreads = 7;
 
+        g_WorkUnit.numThreads = numThreads;
+
+#if TRACE_WORKERS == 1
+        traceInit();
+        traceThread("writer", 0);
+#endif
+
+        char statusFile[1024];
+        sprintf(statusFile, "%s.status.prom", argv[1]);
+        initCampaignStatus();
+
         printf("\nlaunching %d threads...\n", numThreads);
         for (int i = 0; i < numThreads; i++)
         {
@@ -181,8 +414,23 @@ int main(int argc, char *argv[])
         printf("\nWaiting for child threads to finish...\n");
 
         int lastRecordWritten = 0;
+        int secondsRunning = 0;
+#if USE_TRANSPOSITION_TABLE == 1 && USE_TT_SNAPSHOT == 1
+        int secondsSinceSnapshot = 0;
+#endif
         while (WaitForMultipleObjects(numThreads, childThreads, TRUE, /*INFINITE*/ 1000) == WAIT_TIMEOUT)
         {
+#if USE_TRANSPOSITION_TABLE == 1 && USE_TT_SNAPSHOT == 1
+            // so that a restart after a crash/kill doesn't begin with an empty hash table
+            if (++secondsSinceSnapshot >= TT_SNAPSHOT_INTERVAL)
+            {
+                TRACE_BEGIN(snapshotSpan)
+                saveTTSnapshot(TT_SNAPSHOT_FILE);
+                TRACE_END(snapshotSpan, "tt snapshot", -1)
+                secondsSinceSnapshot = 0;
+            }
+#endif
+
             // write output records every 1 second
 
             // figure out lowest completed index
@@ -194,17 +442,28 @@ int main(int argc, char *argv[])
                     minIndex = threadRecent;
             }
 
+            TRACE_BEGIN(writeSpan)
             for (int i = lastRecordWritten; i < minIndex; i++)
             {
                 // printf("\nWriting record: %d\n", i);
                 fprintf(fpOp, "%s", g_WorkUnit.output[i]);
                 fflush(fpOp);
             }
+            if (minIndex > lastRecordWritten)
+            {
+                TRACE_END(writeSpan, "write records", minIndex - lastRecordWritten)
+            }
 
             lastRecordWritten = minIndex;
+
+            updateCampaignStatus(statusFile, ++secondsRunning);
         }
 
+        printCampaignProgress();
+        writeStatusFile(statusFile);
+
         // write remaining records
+        TRACE_BEGIN(writeSpan)
         for (int i = lastRecordWritten; i < g_WorkUnit.totalRecords; i++)
         {
             fprintf(fpOp, "%s", g_WorkUnit.output[i]);
@@ -212,6 +471,28 @@ int main(int argc, char *argv[])
         }
 
         fclose(fpOp);
+        TRACE_END(writeSpan, "write records", g_WorkUnit.totalRecords - lastRecordWritten)
+
+        if (g_perftStats)
+            printPerftStats(7);
+        printNodeStats();
+#if PROFILE_PHASES == 1
+        printPhaseProfile();
+#endif
+
+#if USE_TRANSPOSITION_TABLE == 1 && USE_TT_SNAPSHOT == 1
+        // for the next work unit
+        TRACE_BEGIN(snapshotSpan)
+        saveTTSnapshot(TT_SNAPSHOT_FILE);
+        TRACE_END(snapshotSpan, "tt snapshot", -1)
+#endif
+#if TRACE_WORKERS == 1
+        sprintf(opFile, "%s.trace.json", argv[1]);
+        writeTrace(opFile);
+#endif
+#if USE_RESULT_STORE == 1
+        closeResultStore();
+#endif
         return 0;
     }
 
@@ -279,35 +560,42 @@ int main(int argc, char *argv[])
 #if DEBUG_PRINT_MOVES == 1
         int depth = DEBUG_PRINT_DEPTH;
 #endif
-#if DEBUG_PRINT_UNIQUE_COUNTMOVES == 1        
-        globalCountMovesCounter = 0;
-#endif
+        if (g_perftStats)
+            resetPerftStats();
 
-#if PRINT_HASH_STATS == 1
-        for (int i=0;i<=depth;i++)
+#if USE_RESULT_STORE == 1
+        // (no time to report)
+        if (depth >= RESULT_STORE_MIN_DEPTH && resultStoreOpen() &&
+            lookupResult(computeZobristKey128(&testBB), depth, &bbMoves))
         {
-            numProbes[i] = 0;
-            numHits[i] = 0;
-            numStores[i] = 0;
+            printf("\nPerft %d: %llu,   from the result store\n", depth, bbMoves);
+            continue;
         }
+        uint64 storedBefore = resultStore.numFound;
 #endif
 
+        // keep the hash from the previous depths
+        newTTGeneration();
+
         START_TIMER
+#if USE_INTERLEAVED_PERFT == 1
+        bbMoves = perft_interleaved(&testBB, depth);
+#else
         bbMoves = perft_bb(&testBB, zobristHash, depth);
+#endif
         STOP_TIMER
         printf("\nPerft %d: %llu,   ", depth, bbMoves);
         printf("Time taken: %g seconds, nps: %llu\n", gTime/1000.0, (uint64) ((bbMoves/gTime)*1000.0));
-
-#if DEBUG_PRINT_UNIQUE_COUNTMOVES == 1        
-        printf("No of calls to countMoves: %llu\n", globalCountMovesCounter);
+#if USE_RESULT_STORE == 1
+        // (nps counts the nodes of the subtrees that weren't searched)
+        if (resultStore.numFound > storedBefore)
+            printf("%llu subtrees from the result store, nps is not comparable\n", resultStore.numFound - storedBefore);
 #endif
 
-#if PRINT_HASH_STATS == 1
-    printf("\nHash stats per depth\n");
-    printf("depth   hash probes      hash hits    hash stores\n");
-    for (int i=2; i<=depth; i++)
-        printf("%5d   %11llu    %11llu    %11llu\n", i, numProbes[i], numHits[i], numStores[i]);
-#endif
+        if (g_perftStats)
+            printPerftStats(depth);
+        printNodeStats();
+        resetNodeStats();
 
 #if DEBUG_PRINT_TIME_BREAKUP == 1        
         printf("zobrist computation time: %g seconds, countMoves: %g seconds, makeMove: %g seconds\n", 
@@ -315,8 +603,16 @@ int main(int argc, char *argv[])
             ((double) total_time_in_countMoves.QuadPart) / freq.QuadPart ,
             ((double) total_time_in_makeMove.QuadPart)   / freq.QuadPart);
 #endif
+
+#if PROFILE_PHASES == 1
+        printPhaseProfile();
+        resetPhaseProfile();
+#endif
     }
     
+#if USE_RESULT_STORE == 1
+    closeResultStore();
+#endif
     MoveGeneratorBitboard::destroy();
     return 0;
 }
\ No newline at end of file
@@ -93,8 +93,7 @@ uint32 allocNewRecord(UniquePosRecord *prev)
     if (additionalAlloc == NULL)
     {
         printf("\nAllocating additional memory\n");
-        additionalAlloc = (UniquePosRecord *) malloc(EXTRA_ALLOC_SIZE * sizeof(UniquePosRecord));
-        memset(additionalAlloc, 0, EXTRA_ALLOC_SIZE * sizeof(UniquePosRecord));
+        additionalAlloc = (UniquePosRecord *) allocHashTable(EXTRA_ALLOC_SIZE * sizeof(UniquePosRecord), "additional unique positions");
     }
 
     UniquePosRecord *newEntry = &additionalAlloc[indexInAlloc];
@@ -114,8 +113,8 @@ bool findPositionAndUpdateCounter(HexaBitBoardPosition *pos, uint64 hash, uint32
 {
     if (hashTable == NULL)
     {
-        hashTable = (UniquePosRecord*)malloc(UNIQUE_TABLE_SIZE * sizeof(UniquePosRecord));
-        memset(hashTable, 0, UNIQUE_TABLE_SIZE * sizeof(UniquePosRecord));
+        // zeroed lazily (see TableMemory.h) - a 3.2 GB memset used to be the slowest part of low depths
+        hashTable = (UniquePosRecord*) allocHashTable(UNIQUE_TABLE_SIZE * sizeof(UniquePosRecord), "unique positions table");
     }
 
     UniquePosRecord *record = &hashTable[hash & UNIQUE_TABLE_INDEX_BITS];
@@ -235,9 +234,9 @@ void saveUniquesToFile(int depth)
     printf("\n%d records saved\n", recordsWritten);
 
     // delete the hash table and additional allocation
-    free(hashTable);
+    freeHashTable(hashTable, UNIQUE_TABLE_SIZE * sizeof(UniquePosRecord));
     hashTable = NULL;
-    free(additionalAlloc);
+    freeHashTable(additionalAlloc, EXTRA_ALLOC_SIZE * sizeof(UniquePosRecord));
     additionalAlloc = NULL;
     indexInAlloc = 0;
 }
@@ -256,9 +255,9 @@ void findUniques(int depth)
     HexaBitBoardPosition testBB;
     Utils::board088ToHexBB(&testBB, &testBoard);
 
-    start = clock();
+    clock_t start = clock();
     uint64 count = perft_unique(&testBB, depth);
-    end = clock();
+    clock_t end = clock();
 
     double t = ((double)end - start) / CLOCKS_PER_SEC;
 